@@ -0,0 +1,97 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator. Objects are carved out of large blocks and never freed
+// one by one; release() drops everything at once and keeps the blocks, so
+// a parser that releases after every input stops calling malloc once the
+// arena has grown to its largest input.
+//
+// Only trivially destructible types may live here: nothing runs their
+// destructors.
+class Arena {
+    struct Block {
+        char* data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t current = 0;          // block being filled
+    char* pos = nullptr;
+    char* end = nullptr;
+    size_t block_size;
+    size_t retired = 0;          // bytes handed out from blocks before current
+
+    // Moves to the next block with room for bytes, allocating one if needed
+    void next_block(size_t bytes) {
+        if (pos) retired += pos - blocks[current].data;
+        size_t next = pos ? current + 1 : 0;
+        while (next < blocks.size() && blocks[next].size < bytes) next++;
+        if (next == blocks.size()) {
+            size_t size = bytes > block_size ? bytes : block_size;
+            char* data = static_cast<char*>(std::malloc(size));
+            if (!data) throw std::bad_alloc();
+            blocks.push_back({data, size});
+        }
+        current = next;
+        pos = blocks[current].data;
+        end = pos + blocks[current].size;
+    }
+
+public:
+    explicit Arena(size_t block = 64 << 10) : block_size(block) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() {
+        for (const Block& block : blocks) std::free(block.data);
+    }
+
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+        uintptr_t p = (uintptr_t(pos) + align - 1) & ~uintptr_t(align - 1);
+        if (!pos || p + bytes > uintptr_t(end)) {
+            next_block(bytes + align);
+            p = (uintptr_t(pos) + align - 1) & ~uintptr_t(align - 1);
+        }
+        pos = reinterpret_cast<char*>(p + bytes);
+        return reinterpret_cast<void*>(p);
+    }
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Uninitialized array
+    template <class T>
+    T* make_array(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Forgets every object; the blocks are reused by later allocations
+    void release() {
+        current = 0;
+        retired = 0;
+        pos = nullptr;
+        end = nullptr;
+    }
+
+    // Bytes handed out since the last release, including alignment padding
+    size_t used() const { return retired + (pos ? pos - blocks[current].data : 0); }
+
+    // Bytes held in blocks
+    size_t reserved() const {
+        size_t total = 0;
+        for (const Block& block : blocks) total += block.size;
+        return total;
+    }
+};
+
+#endif
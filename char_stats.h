@@ -0,0 +1,225 @@
+#ifndef CHAR_STATS_H
+#define CHAR_STATS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "thread_pool.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// The counts newcode.l makes, without running a scanner. Its rules are
+//
+//     {VOWEL} {DIGIT} {IDENT} [ \t\n] .
+//
+// so with the longest match and earlier rules winning ties, a run of word
+// bytes [a-zA-Z0-9_] counts its leading digits one by one and the rest as
+// one identifier, unless the rest is a single vowel, which counts as a
+// vowel. Every other byte is a whitespace or a special character.
+//
+// Input is classified 64 bytes at a time into bitmasks, one bit per byte,
+// and runs are found with carries instead of byte loops:
+//
+//     starts  = W & ~(W << 1)              first byte of each word run
+//     leading = ((D + (starts & D)) ^ D) & D
+//                                          digits before a run's first letter
+//     ident   = W & ~leading
+//     first   = ident & ~(ident << 1)      first byte of each identifier
+//
+// where W and D mark word bytes and digits. The addition carries from the
+// start of a run through its digits and stops at the first non-digit. The
+// last bit of each mask carries into the next block.
+struct CharStats {
+    uint64_t vowels = 0;
+    uint64_t identifiers = 0;
+    uint64_t digits = 0;
+    uint64_t whitespaces = 0;
+    uint64_t special_chars = 0;
+
+    CharStats& operator+=(const CharStats& other) {
+        vowels += other.vowels;
+        identifiers += other.identifiers;
+        digits += other.digits;
+        whitespaces += other.whitespaces;
+        special_chars += other.special_chars;
+        return *this;
+    }
+
+    // Class bits of a byte are high[b >> 4] & low[b & 15], the form pshufb
+    // looks up 16 or 32 bytes at once. Each bit is a rectangle of high and
+    // low nibbles: 0 A-O a-o, 1 P-Z p-z, 2 _, 3 0-9, 4 space, 5 \t \n,
+    // 6 AEIO aeio, 7 U u. Bytes from 0x80 have no bits.
+    enum : uint8_t { WORD = 0x0f, DIGIT = 0x08, SPACE = 0x30, VOWEL = 0xc0 };
+    static constexpr uint8_t low_nibble[16] = {0x1a, 0x4b, 0x0b, 0x0b, 0x0b, 0xcb, 0x0b, 0x0b,
+                                               0x0b, 0x6b, 0x23, 0x01, 0x01, 0x01, 0x01, 0x45};
+    static constexpr uint8_t high_nibble[16] = {0x20, 0x00, 0x10, 0x08, 0x41, 0x86, 0x41, 0x82,
+                                                0, 0, 0, 0, 0, 0, 0, 0};
+
+    static uint8_t classify(unsigned char b) { return high_nibble[b >> 4] & low_nibble[b & 15]; }
+
+    // Counts over data; a run that continues past size ends there
+    static CharStats count(const char* data, size_t size) {
+        CharStats stats;
+        Counter counter{stats};
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        size_t full = size / 64 * 64;
+        for (size_t i = 0; i < full; i += 64) counter.block(masks(p + i), ~uint64_t(0));
+        if (size > full) {
+            // Zero padding is a special character, which ends any run
+            unsigned char tail[64] = {};
+            memcpy(tail, p + full, size - full);
+            counter.block(masks(tail), (uint64_t(1) << (size - full)) - 1);
+        }
+        counter.finish();
+        return stats;
+    }
+
+    // count() on pool's threads. Chunks start after a byte that is not a
+    // word byte, where the rules are in the same state as at the start of
+    // the input, so their counts add up; a chunk boundary that falls in a
+    // run moves forward to its end.
+    static CharStats count(const char* data, size_t size, ThreadPool& pool, size_t chunk_bytes = 1 << 22) {
+        chunk_bytes = std::max<size_t>(chunk_bytes, 64);
+        if (pool.size() <= 1 || size <= chunk_bytes) return count(data, size);
+        std::vector<size_t> bounds{0};
+        for (size_t at = chunk_bytes; at < size; at += chunk_bytes) {
+            size_t b = std::max(at, bounds.back());
+            while (b < size && (classify(data[b - 1]) & WORD)) ++b;
+            if (b < size && b > bounds.back()) bounds.push_back(b);
+        }
+        bounds.push_back(size);
+        std::vector<CharStats> parts(bounds.size() - 1);
+        pool.parallel_for(parts.size(), [&](size_t, size_t from, size_t to) {
+            for (size_t c = from; c < to; ++c) parts[c] = count(data + bounds[c], bounds[c + 1] - bounds[c]);
+        });
+        CharStats total;
+        for (const CharStats& part : parts) total += part;
+        return total;
+    }
+
+private:
+    struct Masks {
+        uint64_t word, digit, space, vowel;
+    };
+
+    // Bitmasks of the 64 bytes at p. AVX2 and SSSE3 builds (-mavx2,
+    // -march=native) look classes up with pshufb; plain x86-64 has SSE2.
+    static Masks masks(const unsigned char* p) {
+#if defined(__AVX2__)
+        const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low_nibble)));
+        const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(high_nibble)));
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        const __m256i zero = _mm256_setzero_si256();
+        auto bits = [&](__m256i c, uint8_t which) {
+            __m256i none = _mm256_cmpeq_epi8(_mm256_and_si256(c, _mm256_set1_epi8(char(which))), zero);
+            return ~uint64_t(uint32_t(_mm256_movemask_epi8(none))) & 0xffffffffu;
+        };
+        Masks m{};
+        for (int half = 0; half < 2; ++half) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * half));
+            __m256i c = _mm256_and_si256(_mm256_shuffle_epi8(low, _mm256_and_si256(x, nibble)),
+                                         _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble)));
+            m.word |= bits(c, WORD) << (32 * half);
+            m.digit |= bits(c, DIGIT) << (32 * half);
+            m.space |= bits(c, SPACE) << (32 * half);
+            m.vowel |= bits(c, VOWEL) << (32 * half);
+        }
+        return m;
+#elif defined(__SSSE3__)
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(low_nibble));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(high_nibble));
+        const __m128i nibble = _mm_set1_epi8(0x0f);
+        const __m128i zero = _mm_setzero_si128();
+        auto bits = [&](__m128i c, uint8_t which) {
+            __m128i none = _mm_cmpeq_epi8(_mm_and_si128(c, _mm_set1_epi8(char(which))), zero);
+            return ~uint64_t(_mm_movemask_epi8(none)) & 0xffff;
+        };
+        Masks m{};
+        for (int quarter = 0; quarter < 4; ++quarter) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * quarter));
+            __m128i c = _mm_and_si128(_mm_shuffle_epi8(low, _mm_and_si128(x, nibble)),
+                                      _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(x, 4), nibble)));
+            m.word |= bits(c, WORD) << (16 * quarter);
+            m.digit |= bits(c, DIGIT) << (16 * quarter);
+            m.space |= bits(c, SPACE) << (16 * quarter);
+            m.vowel |= bits(c, VOWEL) << (16 * quarter);
+        }
+        return m;
+#elif defined(__SSE2__)
+        // No pshufb: compare ranges instead, x - low <= width as in ByteRanges
+        const __m128i zero = _mm_setzero_si128();
+        auto in = [&](__m128i x, char low, char width) {
+            return _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(x, _mm_set1_epi8(low)), _mm_set1_epi8(width)), zero);
+        };
+        auto is = [&](__m128i x, char b) { return _mm_cmpeq_epi8(x, _mm_set1_epi8(b)); };
+        auto bits = [](__m128i set) { return uint64_t(_mm_movemask_epi8(set)); };
+        Masks m{};
+        for (int quarter = 0; quarter < 4; ++quarter) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * quarter));
+            __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+            __m128i digit = in(x, '0', 9);
+            __m128i word = _mm_or_si128(_mm_or_si128(in(lower, 'a', 25), is(x, '_')), digit);
+            __m128i space = _mm_or_si128(_mm_or_si128(is(x, ' '), is(x, '\t')), is(x, '\n'));
+            __m128i vowel = _mm_or_si128(_mm_or_si128(_mm_or_si128(is(lower, 'a'), is(lower, 'e')),
+                                                      _mm_or_si128(is(lower, 'i'), is(lower, 'o'))),
+                                         is(lower, 'u'));
+            m.word |= bits(word) << (16 * quarter);
+            m.digit |= bits(digit) << (16 * quarter);
+            m.space |= bits(space) << (16 * quarter);
+            m.vowel |= bits(vowel) << (16 * quarter);
+        }
+        return m;
+#else
+        Masks m{};
+        for (int i = 0; i < 64; ++i) {
+            uint8_t c = classify(p[i]);
+            uint64_t bit = uint64_t(1) << i;
+            if (c & WORD) m.word |= bit;
+            if (c & DIGIT) m.digit |= bit;
+            if (c & SPACE) m.space |= bit;
+            if (c & VOWEL) m.vowel |= bit;
+        }
+        return m;
+#endif
+    }
+
+    // Runs the formulas above block by block into stats
+    struct Counter {
+        CharStats& stats;
+        uint64_t identifier_starts = 0;
+        uint64_t last_word = 0, last_leading = 0, last_ident = 0;   // bit 63 of the previous block
+        bool open_vowel = false;   // the previous block ended with a one-letter identifier so far
+
+        void block(const Masks& m, uint64_t valid) {
+            uint64_t starts = m.word & ~(m.word << 1 | last_word);
+            uint64_t leading = ((m.digit + (starts & m.digit) + last_leading) ^ m.digit) & m.digit;
+            uint64_t ident = m.word & ~leading;
+            uint64_t first = ident & ~(ident << 1 | last_ident);
+            if (open_vowel && !(ident & 1)) stats.vowels++;
+            // A vowel starting an identifier is the whole of it when the
+            // next byte is not in it; for bit 63 the next block decides
+            uint64_t vowel_starts = first & m.vowel;
+            stats.vowels += __builtin_popcountll(vowel_starts & ~(ident >> 1) & ~(uint64_t(1) << 63));
+            open_vowel = vowel_starts >> 63;
+
+            identifier_starts += __builtin_popcountll(first);
+            stats.digits += __builtin_popcountll(leading);
+            stats.whitespaces += __builtin_popcountll(m.space & valid);
+            stats.special_chars += __builtin_popcountll(~(m.word | m.space) & valid);
+            last_word = m.word >> 63;
+            last_leading = leading >> 63;
+            last_ident = ident >> 63;
+        }
+
+        void finish() {
+            if (open_vowel) stats.vowels++;
+            open_vowel = false;
+            stats.identifiers = identifier_starts - stats.vowels;
+        }
+    };
+};
+
+#endif
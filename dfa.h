@@ -0,0 +1,716 @@
+#ifndef DFA_H
+#define DFA_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "nfa.h"
+#include "thread_pool.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// A set of bytes as at most four ranges, so runs of bytes in the set can
+// be skipped 16 or 32 at a time. A byte x is in [low, high] when
+// x - low <= high - low as unsigned bytes, which SSE2 tests with a
+// saturating subtract and a compare with zero.
+struct ByteRanges {
+    static constexpr int max_ranges = 4;
+    int count = 0;
+    uint8_t low[max_ranges];
+    uint8_t high[max_ranges];
+
+    bool contains(unsigned char b) const {
+        for (int i = 0; i < count; ++i) {
+            if (uint8_t(b - low[i]) <= uint8_t(high[i] - low[i])) return true;
+        }
+        return false;
+    }
+
+    // Builds the ranges of a byte set; false if it needs more than four
+    template <class InSet>
+    bool assign(InSet in_set) {
+        count = 0;
+        for (int b = 0; b < 256;) {
+            if (!in_set(b)) {
+                ++b;
+                continue;
+            }
+            int first = b;
+            while (b < 256 && in_set(b)) ++b;
+            if (count == max_ranges) {
+                count = 0;
+                return false;
+            }
+            low[count] = first;
+            high[count] = b - 1;
+            count++;
+        }
+        return count > 0;
+    }
+
+    // First position in [p, end) whose byte is not in the set
+    const unsigned char* skip(const unsigned char* p, const unsigned char* end) const {
+#if defined(__AVX2__)
+        __m256i low32[max_ranges], width32[max_ranges];
+        for (int i = 0; i < count; ++i) {
+            low32[i] = _mm256_set1_epi8(char(low[i]));
+            width32[i] = _mm256_set1_epi8(char(high[i] - low[i]));
+        }
+        const __m256i zero32 = _mm256_setzero_si256();
+        for (; end - p >= 32; p += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i in = zero32;
+            for (int i = 0; i < count; ++i) {
+                __m256i over = _mm256_subs_epu8(_mm256_sub_epi8(x, low32[i]), width32[i]);
+                in = _mm256_or_si256(in, _mm256_cmpeq_epi8(over, zero32));
+            }
+            uint32_t outside = ~uint32_t(_mm256_movemask_epi8(in));
+            if (outside) return p + __builtin_ctz(outside);
+        }
+#endif
+#if defined(__SSE2__)
+        __m128i low16[max_ranges], width16[max_ranges];
+        for (int i = 0; i < count; ++i) {
+            low16[i] = _mm_set1_epi8(char(low[i]));
+            width16[i] = _mm_set1_epi8(char(high[i] - low[i]));
+        }
+        const __m128i zero16 = _mm_setzero_si128();
+        for (; end - p >= 16; p += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i in = zero16;
+            for (int i = 0; i < count; ++i) {
+                __m128i over = _mm_subs_epu8(_mm_sub_epi8(x, low16[i]), width16[i]);
+                in = _mm_or_si128(in, _mm_cmpeq_epi8(over, zero16));
+            }
+            uint32_t outside = ~uint32_t(_mm_movemask_epi8(in)) & 0xffff;
+            if (outside) return p + __builtin_ctz(outside);
+        }
+#endif
+        while (p != end && contains(*p)) ++p;
+        return p;
+    }
+};
+
+// Executable form of a DFA built by nfa.h.
+//
+// Bytes that every state treats alike share an equivalence class, so a row
+// has one cell per class instead of one per byte. Cells hold the offset of
+// the target's row rather than its number, so a step is
+//
+//     state = next[state + classes[byte]]
+//
+// with no multiply. Row 0 is the dead state and accepting states come
+// last, ending with those that have no way out, so "dead", "accepting" and
+// "nothing longer can match" are one compare each. Cells are 16 bits when
+// every row offset fits, 32 bits otherwise.
+//
+// A state that loops on itself, such as the middle of an identifier or a
+// run of blanks, keeps its loop bytes as ByteRanges. When a step lands on
+// the state it left, the rest of the run is skipped with SIMD compares
+// instead of one table step per byte.
+class DenseDFA {
+    std::vector<uint16_t> next16;
+    std::vector<uint32_t> next32;
+    std::vector<int32_t> tokens;    // state -> token kind, -1 if not accepting
+    std::vector<ByteRanges> loops;  // state -> bytes it loops on, count 0 if none or too many ranges
+
+public:
+    struct Match {
+        int32_t token;    // -1 if no prefix matched
+        size_t length;
+    };
+
+    uint16_t classes[256];  // byte -> class; class 0 only leads to the dead state, so 256 bytes can need 257
+    int32_t class_count = 1;
+    int32_t states = 1;     // including the dead state
+    uint32_t start = 0;     // row offset of the start state
+    uint32_t accept_from;   // row offset of the first accepting state
+    uint32_t stop_from;     // row offset of the first accepting state without transitions
+
+    explicit DenseDFA(const DFA& dfa, bool wide = false, bool skip_runs = true) {
+        // Classes: bytes whose columns are equal in every state
+        std::vector<int32_t> column_of(256, -1);
+        for (int32_t c = 0; c < dfa.columns(); ++c) column_of[dfa.alphabet[c]] = c;
+        std::map<std::vector<int32_t>, int32_t> class_of;
+        std::vector<int32_t> class_column{-1};   // class -> a column with its targets
+        class_of.emplace(std::vector<int32_t>(dfa.states, -1), 0);
+        std::vector<int32_t> targets(dfa.states);
+        for (int b = 0; b < 256; ++b) {
+            for (int32_t d = 0; d < dfa.states; ++d) targets[d] = column_of[b] < 0 ? -1 : dfa.go(d, column_of[b]);
+            auto inserted = class_of.emplace(targets, int32_t(class_column.size()));
+            if (inserted.second) class_column.push_back(column_of[b]);
+            classes[b] = inserted.first->second;
+        }
+        class_count = class_column.size();
+
+        // Dead state first, then the states that do not accept, those that
+        // accept and can go on, and those that accept and cannot
+        auto group = [&](int32_t d) {
+            if (dfa.accepting[d] < 0) return 0;
+            for (int32_t c = 0; c < dfa.columns(); ++c) {
+                if (dfa.go(d, c) >= 0) return 1;
+            }
+            return 2;
+        };
+        std::vector<int32_t> row(dfa.states);
+        states = 1;
+        for (int pass = 0; pass < 3; ++pass) {
+            if (pass == 1) accept_from = uint32_t(states) * class_count;
+            if (pass == 2) stop_from = uint32_t(states) * class_count;
+            for (int32_t d = 0; d < dfa.states; ++d) {
+                if (group(d) == pass) row[d] = states++;
+            }
+        }
+        start = dfa.states ? uint32_t(row[dfa.start]) * class_count : 0;
+
+        tokens.assign(states, -1);
+        std::vector<uint32_t> cells(size_t(states) * class_count, 0);
+        for (int32_t d = 0; d < dfa.states; ++d) {
+            tokens[row[d]] = dfa.accepting[d];
+            for (int32_t k = 1; k < class_count; ++k) {
+                int32_t t = dfa.go(d, class_column[k]);
+                if (t >= 0) cells[size_t(row[d]) * class_count + k] = uint32_t(row[t]) * class_count;
+            }
+        }
+
+        loops.assign(states, ByteRanges());
+        for (int32_t s = 1; skip_runs && s < states; ++s) {
+            uint32_t self = uint32_t(s) * class_count;
+            loops[s].assign([&](int b) { return cells[self + classes[b]] == self; });
+        }
+        if (!wide && cells.size() <= 65536) next16.assign(cells.begin(), cells.end());
+        else next32.swap(cells);
+    }
+
+    bool wide() const { return next16.empty(); }
+    int32_t token_at(uint32_t offset) const { return tokens[offset / class_count]; }
+    const ByteRanges& loop_at(uint32_t offset) const { return loops[offset / class_count]; }
+    size_t cell_count() const { return wide() ? next32.size() : next16.size(); }
+    uint32_t cell(size_t i) const { return wide() ? next32[i] : next16[i]; }
+    size_t bytes() const {
+        return sizeof(classes) + next16.size() * sizeof(uint16_t) + next32.size() * sizeof(uint32_t) +
+               tokens.size() * sizeof(int32_t);
+    }
+
+    // Longest prefix of [p, end) that reaches an accepting state
+    Match match(const unsigned char* p, const unsigned char* end) const {
+        return wide() ? match_with(next32.data(), p, end) : match_with(next16.data(), p, end);
+    }
+
+    // Splits data into longest matches, calling on_token(token, offset,
+    // length) for each. A byte that starts no match is reported as token -1
+    // of length 1. Returns the number of tokens.
+    template <class OnToken>
+    size_t tokenize(const char* data, size_t size, OnToken on_token) const {
+        return wide() ? tokenize_with(next32.data(), data, size, on_token)
+                      : tokenize_with(next16.data(), data, size, on_token);
+    }
+
+    // tokenize() with the input cut into chunks that are scanned on the
+    // pool. on_token(chunk, token, offset, length) runs on the workers; the
+    // tokens of one chunk come in order, and chunk c reports the tokens
+    // that tokenize() would report after those of chunk c - 1. Returns the
+    // number of tokens.
+    //
+    // Every chunk is scanned speculatively from its own first byte, as if a
+    // token began there, keeping the tokens it finds. Longest match from a
+    // given start is deterministic, so once the real token stream reaches
+    // one of those starts it follows the speculative one to the end of the
+    // chunk. The real stream is walked in from the previous chunk, which
+    // takes a token or two unless the chunk starts inside something long
+    // like a comment, and the rest of the chunk is replayed from what the
+    // speculative scan kept. Chunks go through in windows of a few per
+    // worker, which bounds the memory for kept tokens.
+    template <class OnToken>
+    size_t tokenize_parallel(const char* data, size_t size, ThreadPool& pool, OnToken on_token,
+                             size_t chunk_bytes = size_t(1) << 20) const {
+        return wide() ? tokenize_parallel_with(next32.data(), data, size, pool, on_token, chunk_bytes)
+                      : tokenize_parallel_with(next16.data(), data, size, pool, on_token, chunk_bytes);
+    }
+
+private:
+    template <class Cell>
+    Match match_with(const Cell* next, const unsigned char* p, const unsigned char* end) const {
+        uint32_t state = start;
+        uint32_t accepted = 0;
+        const unsigned char* q = p;
+        const unsigned char* last = p;
+        while (q != end) {
+            uint32_t from = state;
+            state = next[state + classes[*q++]];
+            if (state == 0) break;
+            if (state == from) {
+                const ByteRanges& loop = loop_at(state);
+                if (loop.count) q = loop.skip(q, end);
+            }
+            if (state >= accept_from) {
+                accepted = state;
+                last = q;
+                if (state >= stop_from) break;
+            }
+        }
+        return {accepted ? token_at(accepted) : -1, size_t(last - p)};
+    }
+
+    template <class Cell, class OnToken>
+    size_t tokenize_with(const Cell* next, const char* data, size_t size, OnToken& on_token) const {
+        const unsigned char* begin = reinterpret_cast<const unsigned char*>(data);
+        const unsigned char* end = begin + size;
+        size_t count = 0;
+        for (const unsigned char* p = begin; p != end; ++count) {
+            Match m = match_with(next, p, end);
+            if (m.length == 0) m = {-1, 1};
+            on_token(m.token, size_t(p - begin), m.length);
+            p += m.length;
+        }
+        return count;
+    }
+
+    template <class Cell, class OnToken>
+    size_t tokenize_parallel_with(const Cell* next, const char* data, size_t size, ThreadPool& pool,
+                                  OnToken& on_token, size_t chunk_bytes) const {
+        const unsigned char* begin = reinterpret_cast<const unsigned char*>(data);
+        const unsigned char* end = begin + size;
+        chunk_bytes = std::min<size_t>(std::max<size_t>(chunk_bytes, 1), size_t(1) << 31);
+        size_t chunks = (size + chunk_bytes - 1) / chunk_bytes;
+
+        struct Chunk {
+            std::vector<uint32_t> starts;   // speculative token starts, from the first byte of the chunk
+            std::vector<int32_t> tokens;
+            size_t exit;                    // first speculative start at or after the end of the chunk
+            std::vector<size_t> walked;     // real token starts before the streams meet
+            std::vector<int32_t> walked_tokens;
+            size_t joined;                  // index in starts where they meet, or starts.size()
+            size_t count;
+        };
+        size_t window = std::max<size_t>(1, pool.size() * 4);
+        std::vector<Chunk> parts(std::min(window, chunks));
+        size_t count = 0, entry = 0;   // entry: real start of the first token of the window
+
+        for (size_t first = 0; first < chunks; first += window) {
+            size_t n = std::min(window, chunks - first);
+            pool.parallel_for(n, [&](size_t, size_t from, size_t to) {
+                for (size_t i = from; i < to; ++i) {
+                    Chunk& part = parts[i];
+                    size_t base = (first + i) * chunk_bytes, limit = std::min(size, base + chunk_bytes);
+                    part.starts.clear();
+                    part.tokens.clear();
+                    size_t offset = base;
+                    while (offset < limit) {
+                        Match m = match_with(next, begin + offset, end);
+                        if (m.length == 0) m = {-1, 1};
+                        part.starts.push_back(uint32_t(offset - base));
+                        part.tokens.push_back(m.token);
+                        offset += m.length;
+                    }
+                    part.exit = offset;
+                }
+            }, n);
+
+            // Walk the real stream into each chunk until it meets the
+            // speculative one or leaves the chunk
+            for (size_t i = 0; i < n; ++i) {
+                Chunk& part = parts[i];
+                size_t base = (first + i) * chunk_bytes, limit = std::min(size, base + chunk_bytes);
+                part.walked.clear();
+                part.walked_tokens.clear();
+                part.joined = part.starts.size();
+                while (entry < limit) {
+                    auto it = std::lower_bound(part.starts.begin(), part.starts.end(), uint32_t(entry - base));
+                    if (it != part.starts.end() && *it == entry - base) {
+                        part.joined = it - part.starts.begin();
+                        break;
+                    }
+                    Match m = match_with(next, begin + entry, end);
+                    if (m.length == 0) m = {-1, 1};
+                    part.walked.push_back(entry);
+                    part.walked_tokens.push_back(m.token);
+                    entry += m.length;
+                }
+                part.walked.push_back(entry);   // end of the last walked token
+                if (part.joined < part.starts.size()) entry = part.exit;
+            }
+
+            pool.parallel_for(n, [&](size_t, size_t from, size_t to) {
+                for (size_t i = from; i < to; ++i) {
+                    Chunk& part = parts[i];
+                    size_t base = (first + i) * chunk_bytes;
+                    for (size_t t = 0; t + 1 < part.walked.size(); ++t) {
+                        on_token(first + i, part.walked_tokens[t], part.walked[t], part.walked[t + 1] - part.walked[t]);
+                    }
+                    size_t kept = part.starts.size();
+                    for (size_t t = part.joined; t < kept; ++t) {
+                        size_t offset = base + part.starts[t];
+                        size_t length = t + 1 < kept ? part.starts[t + 1] - part.starts[t] : part.exit - offset;
+                        on_token(first + i, part.tokens[t], offset, length);
+                    }
+                    part.count = part.walked.size() - 1 + (kept - part.joined);
+                }
+            }, n);
+            for (size_t i = 0; i < n; ++i) count += parts[i].count;
+        }
+        return count;
+    }
+};
+
+// DFA built on demand while matching.
+//
+// Subset construction runs one transition at a time, the first time the
+// input takes it, and the states and transitions found so far are cached.
+// The cache is bounded: when a new state would take it past the memory
+// limit it is flushed and rebuilt from the state being entered. Patterns
+// whose full DFA is exponential, such as (a|b)*a(a|b){n}, then match in
+// bounded memory, at DFA speed as long as the input keeps to states that
+// are cached.
+class LazyDFA {
+    static constexpr int32_t unknown = -2;
+    static constexpr int32_t dead = -1;
+
+    CompiledNFA nfa;
+    SubsetStepper stepper;
+    StateSetTable sets;
+    std::vector<int32_t> next;     // [state * class_count + class] -> state, dead or unknown
+    std::vector<int32_t> tokens;   // state -> token kind, -1 if not accepting
+    std::vector<int32_t> start_set, scratch;
+    uint16_t classes[256];         // byte -> column + 1, 0 if not in the alphabet
+    int32_t class_count;
+    int32_t start = 0;
+    size_t memory_limit;
+
+    int32_t add_state(const std::vector<int32_t>& set) {
+        auto interned = sets.intern(set.data(), set.data() + set.size());
+        if (interned.second) {
+            next.resize(next.size() + class_count, unknown);
+            next[size_t(interned.first) * class_count] = dead;
+            tokens.push_back(nfa.token_of(set.data(), set.data() + set.size()));
+            stats.states++;
+        }
+        return interned.first;
+    }
+
+    void flush() {
+        sets.clear();
+        next.clear();
+        tokens.clear();
+        start = add_state(start_set);
+        stats.flushes++;
+    }
+
+    // Fills in a transition the cache does not know yet
+    int32_t compute(int32_t state, int32_t cls) {
+        stats.misses++;
+        stepper.step(sets.begin(state), sets.end(state), cls - 1, scratch);
+        if (scratch.empty()) return next[size_t(state) * class_count + cls] = dead;
+        size_t grown = bytes() + (class_count + scratch.size() + 8) * sizeof(int32_t);
+        if (grown > memory_limit && sets.size() > 1) {
+            // The source state is gone after the flush; only the target is rebuilt
+            flush();
+            return add_state(scratch);
+        }
+        int32_t target = add_state(scratch);
+        next[size_t(state) * class_count + cls] = target;
+        return target;
+    }
+
+public:
+    struct Stats {
+        size_t steps = 0;     // transitions taken
+        size_t misses = 0;    // transitions computed from the NFA
+        size_t states = 0;    // states built, counting rebuilds after a flush
+        size_t flushes = 0;
+        size_t hits() const { return steps - misses; }
+    };
+    Stats stats;
+
+    explicit LazyDFA(CompiledNFA compiled, size_t limit = 1 << 20)
+        : nfa(std::move(compiled)), stepper(nfa), class_count(nfa.columns() + 1), memory_limit(limit) {
+        for (int b = 0; b < 256; ++b) classes[b] = nfa.column_of[b] + 1;
+        if (nfa.start >= 0) {
+            start_set.push_back(nfa.start);
+            stepper.close(start_set);
+        }
+        start = add_state(start_set);
+    }
+    LazyDFA(const LazyDFA&) = delete;
+    LazyDFA& operator=(const LazyDFA&) = delete;
+
+    // Bytes held by the cache
+    size_t bytes() const { return sets.bytes() + (next.size() + tokens.size()) * sizeof(int32_t); }
+    int32_t cached_states() const { return sets.size(); }
+
+    // Longest prefix of [p, end) that reaches an accepting state
+    DenseDFA::Match match(const unsigned char* p, const unsigned char* end) {
+        int32_t state = start;
+        int32_t accepted = -1;
+        const unsigned char* q = p;
+        const unsigned char* last = p;
+        while (q != end) {
+            int32_t cls = classes[*q++];
+            int32_t target = next[size_t(state) * class_count + cls];
+            if (target == unknown) target = compute(state, cls);
+            if (target == dead) break;
+            state = target;
+            if (tokens[state] >= 0) {
+                accepted = tokens[state];
+                last = q;
+            }
+        }
+        stats.steps += q - p;
+        return {accepted, size_t(last - p)};
+    }
+
+    // As DenseDFA::tokenize
+    template <class OnToken>
+    size_t tokenize(const char* data, size_t size, OnToken on_token) {
+        const unsigned char* begin = reinterpret_cast<const unsigned char*>(data);
+        const unsigned char* end = begin + size;
+        size_t count = 0;
+        for (const unsigned char* p = begin; p != end; ++count) {
+            DenseDFA::Match m = match(p, end);
+            if (m.length == 0) m = {-1, 1};
+            on_token(m.token, size_t(p - begin), m.length);
+            p += m.length;
+        }
+        return count;
+    }
+};
+
+// NFA simulation without subset construction, for NFAs with at most
+// 64 * Words positions.
+//
+// A position is the group of transitions from one NFA state to another,
+// with the bytes they read. The simulation tracks the positions taken by
+// the last byte rather than NFA states, and every way into a position
+// reads one of its bytes, so a step is
+//
+//     active = follow(active) & reads[byte]
+//
+// where follow(active) holds every position that can come after an active
+// one, epsilon moves included. It is looked up 8 positions at a time in
+// tables of all 256 combinations, so a byte costs one load and OR per 8
+// positions and word. Position 0 stands for the start state.
+template <int Words>
+class BitParallelNFA {
+public:
+    static constexpr int32_t max_positions = 64 * Words;
+    using Bits = std::array<uint64_t, Words>;
+
+private:
+    int32_t count = 1;               // positions, including the start
+    int32_t slices = 1;              // groups of 8 positions
+    std::vector<Bits> follow_table;  // [slice * 256 + bits of the slice] -> follow sets of those positions
+    Bits reads[256] = {};            // byte -> positions that read it
+    Bits first[256] = {};            // byte -> positions active after reading it from the start
+    Bits accepting = {};
+    std::vector<int32_t> tokens;     // position -> token kind, -1 if not accepting
+
+    static void set(Bits& bits, int32_t i) { bits[i >> 6] |= uint64_t(1) << (i & 63); }
+
+    // Position p for each target of state s, with the bytes that lead there
+    static std::map<int32_t, std::vector<unsigned char>> targets(const CompiledNFA& nfa, int32_t s) {
+        std::map<int32_t, std::vector<unsigned char>> bytes_to;
+        for (int32_t e = nfa.move_offsets[s]; e < nfa.move_offsets[s + 1]; ++e) {
+            bytes_to[nfa.moves[e].second].push_back(nfa.alphabet[nfa.moves[e].first]);
+        }
+        return bytes_to;
+    }
+
+public:
+    // Positions of the NFA, counting the start
+    static int32_t positions(const CompiledNFA& nfa) {
+        int32_t n = 1;
+        for (int32_t s = 0; s < nfa.states(); ++s) n += targets(nfa, s).size();
+        return n;
+    }
+
+    explicit BitParallelNFA(const CompiledNFA& nfa) {
+        if (nfa.start < 0) {
+            tokens.assign(1, -1);
+            follow_table.assign(256, Bits{});
+            return;
+        }
+        // Positions leaving each state are numbered consecutively
+        std::vector<int32_t> first_out(nfa.states() + 1, 0);
+        std::vector<int32_t> target_of{nfa.start};
+        for (int32_t s = 0; s < nfa.states(); ++s) {
+            first_out[s] = target_of.size();
+            for (const auto& target : targets(nfa, s)) {
+                if (int32_t(target_of.size()) == max_positions) {
+                    throw std::length_error("NFA has more positions than BitParallelNFA holds");
+                }
+                for (unsigned char b : target.second) set(reads[b], target_of.size());
+                target_of.push_back(target.first);
+            }
+        }
+        first_out[nfa.states()] = target_of.size();
+        count = target_of.size();
+        slices = (count + 7) / 8;
+
+        // Follow sets: the positions out of every state in the closure of
+        // the target
+        std::vector<Bits> follow(count, Bits{});
+        tokens.assign(count, -1);
+        for (int32_t p = 0; p < count; ++p) {
+            const int32_t* last = nfa.closures.end(target_of[p]);
+            for (const int32_t* s = nfa.closures.begin(target_of[p]); s != last; ++s) {
+                for (int32_t q = first_out[*s]; q < first_out[*s + 1]; ++q) set(follow[p], q);
+            }
+            if (p == 0) continue;   // the empty match does not count
+            tokens[p] = nfa.token_of(nfa.closures.begin(target_of[p]), last);
+            if (tokens[p] >= 0) set(accepting, p);
+        }
+
+        for (int b = 0; b < 256; ++b) {
+            for (int w = 0; w < Words; ++w) first[b][w] = follow[0][w] & reads[b][w];
+        }
+
+        // Every combination within a slice is one more position than a
+        // combination already built
+        follow_table.assign(size_t(slices) * 256, Bits{});
+        for (int32_t k = 0; k < slices; ++k) {
+            Bits* table = follow_table.data() + size_t(k) * 256;
+            for (int v = 1; v < 256; ++v) {
+                int32_t p = k * 8 + __builtin_ctz(v);
+                table[v] = table[v & (v - 1)];
+                if (p >= count) continue;
+                for (int w = 0; w < Words; ++w) table[v][w] |= follow[p][w];
+            }
+        }
+    }
+
+    int32_t size() const { return count; }
+    size_t bytes() const {
+        return follow_table.size() * sizeof(Bits) + sizeof(reads) + sizeof(first) + tokens.size() * sizeof(int32_t);
+    }
+
+    // Longest prefix of [p, end) that reaches an accepting state
+    DenseDFA::Match match(const unsigned char* p, const unsigned char* end) const {
+        int32_t accepted = -1;
+        const unsigned char* q = p;
+        const unsigned char* last = p;
+        if (q == end) return {accepted, 0};
+        Bits active = first[*q++];
+        for (;;) {
+            uint64_t any = 0, accepts = 0;
+            for (int w = 0; w < Words; ++w) {
+                any |= active[w];
+                accepts |= active[w] & accepting[w];
+            }
+            if (!any) break;
+            if (accepts) {
+                // Smallest token among the accepting positions, usually one
+                accepted = -1;
+                for (int w = 0; w < Words; ++w) {
+                    for (uint64_t bits = active[w] & accepting[w]; bits; bits &= bits - 1) {
+                        int32_t t = tokens[w * 64 + __builtin_ctzll(bits)];
+                        if (accepted < 0 || t < accepted) accepted = t;
+                    }
+                }
+                last = q;
+            }
+            if (q == end) break;
+
+            // Few positions are active at a time; only their slices are read
+            Bits next{};
+            for (int w = 0; w < Words; ++w) {
+                for (uint64_t bits = active[w]; bits;) {
+                    int shift = __builtin_ctzll(bits) & ~7;
+                    const Bits& f = follow_table[size_t(w * 8 + shift / 8) * 256 + ((bits >> shift) & 0xff)];
+                    for (int x = 0; x < Words; ++x) next[x] |= f[x];
+                    bits &= ~(uint64_t(0xff) << shift);
+                }
+            }
+            const Bits& read = reads[*q++];
+            for (int w = 0; w < Words; ++w) active[w] = next[w] & read[w];
+        }
+        return {accepted, size_t(last - p)};
+    }
+
+    // As DenseDFA::tokenize
+    template <class OnToken>
+    size_t tokenize(const char* data, size_t size, OnToken on_token) const {
+        const unsigned char* begin = reinterpret_cast<const unsigned char*>(data);
+        const unsigned char* end = begin + size;
+        size_t emitted = 0;
+        for (const unsigned char* p = begin; p != end; ++emitted) {
+            DenseDFA::Match m = match(p, end);
+            if (m.length == 0) m = {-1, 1};
+            on_token(m.token, size_t(p - begin), m.length);
+            p += m.length;
+        }
+        return emitted;
+    }
+};
+
+// Matcher for an NFA that picks its engine by size. Up to bit_parallel_limit
+// positions (at most 256) the NFA is simulated bit-parallel and subset
+// construction is skipped entirely; above that it is determinized,
+// minimized and run as a DenseDFA. A bit-parallel step is slower than a
+// table step, so callers with long inputs can pass a lower limit.
+class AutoMatcher {
+public:
+    enum Engine { BIT_PARALLEL_64, BIT_PARALLEL_128, BIT_PARALLEL_256, DENSE_DFA };
+
+private:
+    Engine kind;
+    std::unique_ptr<BitParallelNFA<1>> bits64;
+    std::unique_ptr<BitParallelNFA<2>> bits128;
+    std::unique_ptr<BitParallelNFA<4>> bits256;
+    std::unique_ptr<DenseDFA> dense;
+
+    template <class F>
+    auto visit(F f) const {
+        switch (kind) {
+        case BIT_PARALLEL_64: return f(*bits64);
+        case BIT_PARALLEL_128: return f(*bits128);
+        case BIT_PARALLEL_256: return f(*bits256);
+        default: return f(*dense);
+        }
+    }
+
+public:
+    explicit AutoMatcher(const NFAToDFAConverter& nfa, int32_t bit_parallel_limit = 256) {
+        CompiledNFA compiled = nfa.compile();
+        int32_t positions = BitParallelNFA<1>::positions(compiled);
+        if (positions <= std::min(bit_parallel_limit, BitParallelNFA<1>::max_positions)) {
+            kind = BIT_PARALLEL_64;
+            bits64.reset(new BitParallelNFA<1>(compiled));
+        } else if (positions <= std::min(bit_parallel_limit, BitParallelNFA<2>::max_positions)) {
+            kind = BIT_PARALLEL_128;
+            bits128.reset(new BitParallelNFA<2>(compiled));
+        } else if (positions <= std::min(bit_parallel_limit, BitParallelNFA<4>::max_positions)) {
+            kind = BIT_PARALLEL_256;
+            bits256.reset(new BitParallelNFA<4>(compiled));
+        } else {
+            kind = DENSE_DFA;
+            dense.reset(new DenseDFA(minimize_dfa(nfa.determinize())));
+        }
+    }
+
+    Engine engine() const { return kind; }
+    const char* engine_name() const {
+        static const char* names[] = {"bit-parallel, 64", "bit-parallel, 128", "bit-parallel, 256", "dense DFA"};
+        return names[kind];
+    }
+    size_t bytes() const {
+        return visit([](const auto& engine) { return engine.bytes(); });
+    }
+
+    DenseDFA::Match match(const unsigned char* p, const unsigned char* end) const {
+        return visit([&](const auto& engine) { return engine.match(p, end); });
+    }
+
+    // As DenseDFA::tokenize
+    template <class OnToken>
+    size_t tokenize(const char* data, size_t size, OnToken on_token) const {
+        return visit([&](const auto& engine) { return engine.tokenize(data, size, on_token); });
+    }
+};
+
+#endif
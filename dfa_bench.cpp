@@ -0,0 +1,389 @@
+// Throughput of the matching engines in dfa.h.
+//
+// Builds a tokenizer DFA for C-like source (keywords, identifiers,
+// numbers, whitespace, operators, as in newcode.l), minimizes it, and
+// tokenizes a buffer by longest match with 16-bit and 32-bit cells, with
+// and without SIMD run skipping, with the lazy DFA, in --chunk-kb chunks
+// on --jobs threads, and with the engine AutoMatcher picks for the NFA. The input is a file (mapped with mmap) or
+// generated source text; --passes scans it repeatedly, so multi-GB totals
+// fit in a modest buffer. Every engine must report the same tokens at the
+// same offsets, and all of them must match a run over the full byte
+// alphabet and tell apart 256 one-byte tokens before anything else runs.
+//
+// --blowup N instead scans random a/b text for (a|b)*a(a|b){N}, whose
+// full DFA has 2^(N+1) states, comparing full determinization with the
+// lazy DFA under --cache-kb.
+//
+//   g++ -std=c++17 -O2 -pthread -o dfa_bench dfa_bench.cpp
+//   ./dfa_bench --mb 256 --passes 8
+//   ./dfa_bench --file big.c --jobs 8
+//   ./dfa_bench --blowup 20 --cache-kb 256
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "dfa.h"
+
+using namespace std;
+
+enum Token { KEYWORD, IDENT, NUMBER, WHITESPACE, COMMENT, OPERATOR, PUNCT, TOKEN_KINDS };
+const char* token_names[] = {"keyword", "identifier", "number", "whitespace", "comment", "operator", "punctuation"};
+
+// Tokenizer NFA built by hand: one branch per rule from the start state
+class TokenizerNFA {
+    NFAToDFAConverter& nfa;
+    int next_state = 1;
+
+    void range(int from, int to, int low, int high) {
+        for (int c = low; c <= high; ++c) nfa.add_transition(from, char(c), to);
+    }
+
+public:
+    explicit TokenizerNFA(NFAToDFAConverter& target) : nfa(target) { nfa.set_start_state(0); }
+
+    // Exact string
+    void literal(const string& text, int token) {
+        int state = next_state++;
+        nfa.add_epsilon_transition(0, state);
+        for (char c : text) {
+            nfa.add_transition(state, c, next_state);
+            state = next_state++;
+        }
+        nfa.add_final_state(state, token);
+    }
+
+    // prefix[rest]* with rest given as byte ranges
+    void prefixed(const string& prefix, const vector<pair<int, int>>& rest, int token) {
+        int state = next_state++;
+        nfa.add_epsilon_transition(0, state);
+        for (char c : prefix) {
+            nfa.add_transition(state, c, next_state);
+            state = next_state++;
+        }
+        for (auto r : rest) range(state, state, r.first, r.second);
+        nfa.add_final_state(state, token);
+    }
+
+    // [first][rest]* given as ranges
+    void word(const vector<pair<int, int>>& first, const vector<pair<int, int>>& rest, int token) {
+        int begin = next_state++, end = next_state++;
+        nfa.add_epsilon_transition(0, begin);
+        for (auto r : first) range(begin, end, r.first, r.second);
+        for (auto r : rest) range(end, end, r.first, r.second);
+        nfa.add_final_state(end, token);
+    }
+};
+
+void build_tokenizer(NFAToDFAConverter& nfa) {
+    TokenizerNFA rules(nfa);
+    for (const char* k : {"int", "char", "if", "else", "while", "for", "return", "struct", "void"}) {
+        rules.literal(k, KEYWORD);
+    }
+    rules.word({{'a', 'z'}, {'A', 'Z'}, {'_', '_'}}, {{'a', 'z'}, {'A', 'Z'}, {'0', '9'}, {'_', '_'}}, IDENT);
+    rules.word({{'0', '9'}}, {{'0', '9'}}, NUMBER);
+    rules.word({{' ', ' '}, {'\t', '\t'}, {'\n', '\n'}}, {{' ', ' '}, {'\t', '\t'}, {'\n', '\n'}}, WHITESPACE);
+    rules.prefixed("//", {{0, '\n' - 1}, {'\n' + 1, 255}}, COMMENT);
+    for (const char* op : {"==", "!=", "<=", ">=", "&&", "||", "++", "--", "+", "-", "*", "/", "=", "<", ">", "!"}) {
+        rules.literal(op, OPERATOR);
+    }
+    for (const char* p : {"(", ")", "{", "}", "[", "]", ";", ","}) rules.literal(p, PUNCT);
+}
+
+// (a|b)*a(a|b){n}: the n+1'th symbol from the end is an a
+void build_blowup(NFAToDFAConverter& nfa, int n) {
+    nfa.set_start_state(0);
+    nfa.add_transition(0, 'a', 0);
+    nfa.add_transition(0, 'b', 0);
+    nfa.add_transition(0, 'a', 1);
+    for (int i = 1; i <= n; ++i) {
+        nfa.add_transition(i, 'a', i + 1);
+        nfa.add_transition(i, 'b', i + 1);
+    }
+    nfa.add_final_state(n + 1);
+}
+
+// Random C-like text: statements on indented lines, some with comments
+string generate_source(size_t bytes, unsigned seed) {
+    mt19937 rng(seed);
+    const char* words[] = {"int", "return", "while", "count", "x", "buffer_size", "i", "node", "value2", "if"};
+    const char* ops[] = {" = ", " + ", " == ", " <= ", "++", " && ", " * ", "(", ")", ", "};
+    const char* comments[] = {"// advance to the next node in the list", "// TODO: handle overflow",
+                              "// the caller owns the returned buffer and must free it"};
+    string text;
+    text.reserve(bytes + 256);
+    while (text.size() < bytes) {
+        text += string(4 * (1 + rng() % 3), ' ');
+        for (int n = 3 + rng() % 8; n > 0; --n) {
+            switch (rng() % 3) {
+            case 0: text += words[rng() % 10]; break;
+            case 1: text += to_string(rng() % 100000); break;
+            default: text += ops[rng() % 10]; break;
+            }
+        }
+        text += ";";
+        if (rng() % 4 == 0) text += string("  ") + comments[rng() % 3];
+        text += "\n";
+    }
+    text.resize(bytes);
+    return text;
+}
+
+struct ScanResult {
+    double seconds = 0;
+    size_t tokens = 0;
+    size_t counts[TOKEN_KINDS + 1] = {};   // last: bytes that match nothing
+    uint64_t digest = 0;                   // sum of token_hash() over the tokens
+
+    void add(int32_t token, size_t offset, size_t length) {
+        counts[token < 0 ? TOKEN_KINDS : token]++;
+        // Offsets differ between tokens, so equal sums mean equal streams
+        // with overwhelming probability, in whatever order they are added
+        uint64_t h = (uint64_t(offset) * 0x9e3779b97f4a7c15ull) ^ (uint64_t(length) << 32) ^ uint32_t(token);
+        h ^= h >> 29;
+        digest += h * 0xbf58476d1ce4e5b9ull;
+    }
+};
+
+template <class Table>
+ScanResult scan(Table& table, const char* data, size_t size, int passes) {
+    ScanResult result;
+    auto start = chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        result.tokens += table.tokenize(data, size, [&](int32_t token, size_t offset, size_t length) {
+            result.add(token, offset, length);
+        });
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// scan() with tokenize_parallel, adding up one result per chunk
+ScanResult scan_parallel(const DenseDFA& table, const char* data, size_t size, int passes, ThreadPool& pool,
+                         size_t chunk_bytes) {
+    ScanResult result;
+    vector<ScanResult> parts((size + chunk_bytes - 1) / chunk_bytes);
+    auto start = chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        result.tokens += table.tokenize_parallel(data, size, pool, [&](size_t chunk, int32_t token, size_t offset,
+                                                                      size_t length) {
+            parts[chunk].add(token, offset, length);
+        }, chunk_bytes);
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (const ScanResult& part : parts) {
+        for (int k = 0; k <= TOKEN_KINDS; ++k) result.counts[k] += part.counts[k];
+        result.digest += part.digest;
+    }
+    return result;
+}
+
+void print_lazy_stats(const LazyDFA& lazy) {
+    const LazyDFA::Stats& stats = lazy.stats;
+    cout << "Lazy DFA: " << stats.hits() << " hits, " << stats.misses << " misses ("
+         << setprecision(4) << 100.0 * stats.misses / max<size_t>(1, stats.steps) << "%), " << stats.states
+         << " states built, " << stats.flushes << " flushes, " << lazy.cached_states() << " states / "
+         << lazy.bytes() << " bytes cached at the end\n";
+}
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int run_blowup(int n, size_t megabytes, size_t cache_kb, int full_limit, unsigned seed) {
+    NFAToDFAConverter nfa;
+    build_blowup(nfa, n);
+    string text(megabytes << 20, 'a');
+    mt19937 rng(seed);
+    for (char& c : text) c = rng() & 1 ? 'a' : 'b';
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(text.data());
+    const unsigned char* end = begin + text.size();
+    double mb = double(text.size()) / (1 << 20);
+    cout << "(a|b)*a(a|b){" << n << "} over " << megabytes << " MB of random a/b text\n\n";
+
+    cout << fixed << setprecision(1);
+    if (n <= full_limit) {
+        auto start = chrono::steady_clock::now();
+        DFA dfa = nfa.determinize();
+        double build = seconds_since(start);
+        DenseDFA table(dfa);
+        start = chrono::steady_clock::now();
+        DenseDFA::Match m = table.match(begin, end);
+        double scan_seconds = seconds_since(start);
+        cout << "Full DFA: " << dfa.states << " states built in " << build * 1000 << " ms, " << table.bytes()
+             << " table bytes, " << mb / scan_seconds << " MB/s, last match ends at " << m.length << "\n";
+    } else {
+        cout << "Full DFA: skipped, 2^" << n + 1 << " states (raise --full-limit to build it)\n";
+    }
+
+    LazyDFA lazy(nfa.compile(), cache_kb << 10);
+    auto start = chrono::steady_clock::now();
+    DenseDFA::Match m = lazy.match(begin, end);
+    double scan_seconds = seconds_since(start);
+    cout << "Lazy DFA, " << cache_kb << " KB cache: " << mb / scan_seconds << " MB/s, last match ends at "
+         << m.length << "\n";
+    print_lazy_stats(lazy);
+    return 0;
+}
+
+// An NFA whose alphabet is all 256 bytes, as for (.|\n)* or [\x00-\xff]:
+// the last byte value sits at the edge of every byte -> class table. Each
+// engine must match the whole input, which ends in 0xff bytes.
+bool full_alphabet_ok() {
+    NFAToDFAConverter nfa;
+    nfa.set_start_state(0);
+    for (int c = 0; c < 256; ++c) {
+        nfa.add_transition(0, char(c), 1);
+        nfa.add_transition(1, char(c), 1);
+    }
+    nfa.add_final_state(1, 0);
+    string text = "a\xff" "b\xff";
+    for (int c = 255; c >= 0; --c) text += char(c);
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(text.data());
+    const unsigned char* end = begin + text.size();
+
+    DenseDFA table(minimize_dfa(nfa.determinize()));
+    LazyDFA lazy(nfa.compile());
+    AutoMatcher automatic(nfa);
+    size_t lengths[] = {table.match(begin, end).length, lazy.match(begin, end).length,
+                        automatic.match(begin, end).length};
+    bool ok = true;
+    for (size_t length : lengths) ok &= length == text.size();
+    if (!ok) cout << "MISMATCH on the full byte alphabet\n";
+    return ok;
+}
+
+// One single-byte token per byte value: 256 distinct classes, plus the one
+// DenseDFA keeps for bytes outside the alphabet. Every byte must match as
+// its own token.
+bool distinct_bytes_ok() {
+    NFAToDFAConverter nfa;
+    nfa.set_start_state(0);
+    for (int c = 0; c < 256; ++c) {
+        nfa.add_transition(0, char(c), 1 + c);
+        nfa.add_final_state(1 + c, c);
+    }
+    DenseDFA table(minimize_dfa(nfa.determinize()));
+    LazyDFA lazy(nfa.compile());
+    AutoMatcher automatic(nfa);
+    bool ok = true;
+    for (int c = 0; c < 256; ++c) {
+        unsigned char byte = c;
+        DenseDFA::Match matches[] = {table.match(&byte, &byte + 1), lazy.match(&byte, &byte + 1),
+                                     automatic.match(&byte, &byte + 1)};
+        for (const DenseDFA::Match& m : matches) ok &= m.token == c && m.length == 1;
+    }
+    if (!ok) cout << "MISMATCH with a class for every byte\n";
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = 256;
+    int passes = 8;
+    unsigned seed = 1;
+    string path;
+    int blowup = -1;
+    int full_limit = 18;
+    size_t cache_kb = 1024;
+    unsigned jobs = 0;
+    size_t chunk_kb = 4096;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        string value = argv[i + 1];
+        if (flag == "--mb") megabytes = stoul(value);
+        else if (flag == "--passes") passes = max(1, stoi(value));
+        else if (flag == "--seed") seed = stoul(value);
+        else if (flag == "--file") path = value;
+        else if (flag == "--blowup") blowup = stoi(value);
+        else if (flag == "--full-limit") full_limit = stoi(value);
+        else if (flag == "--cache-kb") cache_kb = stoul(value);
+        else if (flag == "--jobs") jobs = stoul(value);
+        else if (flag == "--chunk-kb") chunk_kb = max<size_t>(1, stoul(value));
+        else {
+            cout << "Unknown option: " << flag << "\n";
+            return 1;
+        }
+    }
+
+    if (!full_alphabet_ok() || !distinct_bytes_ok()) return 1;
+    if (blowup >= 0) return run_blowup(blowup, megabytes == 256 ? 16 : megabytes, cache_kb, full_limit, seed);
+
+    NFAToDFAConverter nfa;
+    build_tokenizer(nfa);
+    DFA dfa = nfa.determinize();
+    DFA minimal = minimize_dfa(dfa);
+    DenseDFA narrow(minimal), wide(minimal, true), stepping(minimal, false, false);
+    cout << "Tokenizer DFA: " << dfa.states << " states, " << minimal.states << " minimized, "
+         << minimal.columns() << " input bytes in " << narrow.class_count << " classes\n"
+         << "Table: " << narrow.bytes() << " bytes with " << (narrow.wide() ? 32 : 16) << "-bit cells, "
+         << wide.bytes() << " bytes with 32-bit cells\n";
+
+    // Input
+    string generated;
+    const char* data;
+    size_t size;
+    void* mapped = MAP_FAILED;
+    if (!path.empty()) {
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            cout << "Error: cannot open " << path << "\n";
+            return 1;
+        }
+        size = st.st_size;
+        mapped = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (size && mapped == MAP_FAILED) {
+            cout << "Error: mmap failed for " << path << "\n";
+            return 1;
+        }
+        data = static_cast<const char*>(mapped);
+        cout << "Input: " << path << ", " << size << " bytes x " << passes << " passes\n\n";
+    } else {
+        generated = generate_source(megabytes << 20, seed);
+        data = generated.data();
+        size = generated.size();
+        cout << "Input: " << megabytes << " MB generated x " << passes << " passes\n\n";
+    }
+
+    cout << left << setw(20) << "engine" << right << setw(12) << "MB/s" << setw(16) << "Mtokens/s" << "\n";
+    LazyDFA lazy(nfa.compile(), cache_kb << 10);
+    ThreadPool pool(jobs);
+    string parallel = string(narrow.wide() ? "32-bit" : "16-bit") + ", -j" + to_string(pool.size());
+    AutoMatcher automatic(nfa);
+    const int engine_count = 6;
+    ScanResult results[engine_count] = {scan(narrow, data, size, passes), scan(stepping, data, size, passes),
+                                        scan(wide, data, size, passes), scan(lazy, data, size, passes),
+                                        scan_parallel(narrow, data, size, passes, pool, chunk_kb << 10),
+                                        scan(automatic, data, size, passes)};
+    const char* engines[engine_count] = {narrow.wide() ? "32-bit" : "16-bit",
+                                         stepping.wide() ? "32-bit, no skip" : "16-bit, no skip", "32-bit", "lazy",
+                                         parallel.c_str(), automatic.engine_name()};
+    double mb = double(size) * passes / (1 << 20);
+    for (int t = 0; t < engine_count; ++t) {
+        cout << left << setw(20) << engines[t] << right << fixed << setprecision(1) << setw(12)
+             << mb / results[t].seconds << setw(16) << results[t].tokens / results[t].seconds / 1e6 << "\n";
+    }
+    cout << "\n";
+    print_lazy_stats(lazy);
+
+    cout << "\nTokens per pass:\n";
+    bool same = true;
+    for (int t = 1; t < engine_count; ++t) same &= results[0].digest == results[t].digest;
+    for (int k = 0; k <= TOKEN_KINDS; ++k) {
+        for (int t = 1; t < engine_count; ++t) same &= results[0].counts[k] == results[t].counts[k];
+        cout << "  " << left << setw(14) << (k < TOKEN_KINDS ? token_names[k] : "unmatched") << right
+             << results[0].counts[k] / passes << "\n";
+    }
+    if (!same) cout << "MISMATCH between engines\n";
+
+    if (mapped != MAP_FAILED) munmap(mapped, size);
+    return same ? 0 : 1;
+}
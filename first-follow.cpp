@@ -1,200 +1,454 @@
 #include <iostream>
 #include <vector>
-#include <set>
-#include <map>
-#include <algorithm>
 #include <string>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include "grammar.h"
 
 using namespace std;
 
 class FirstFollowCalculator {
+public:
+    // Names of the non-terminals whose sets changed in a recompute()
+    struct SetChanges {
+        vector<string> first;
+        vector<string> follow;
+    };
+
 private:
-    // Grammar representation
-    map<char, vector<string>> productions;
-    // Set of non-terminals
-    set<char> non_terminals;
-    // Set of terminals
-    set<char> terminals;
-
-    // Helper function to check if a symbol is a non-terminal
-    bool is_non_terminal(char symbol) {
-        return non_terminals.find(symbol) != non_terminals.end();
-    }
-
-    // Calculate FIRST set for a single symbol
-    set<char> calculate_first_of_symbol(char symbol) {
-        set<char> first_set;
-        
-        // If it's a terminal, FIRST is the symbol itself
-        if (!is_non_terminal(symbol) && symbol != 'e') {
-            first_set.insert(symbol);
-            return first_set;
-        }
-        
-        // If it's epsilon, add epsilon
-        if (symbol == 'e') {
-            first_set.insert('e');
-            return first_set;
-        }
-        
-        // For non-terminals, go through their productions
-        for (const auto& production : productions[symbol]) {
-            bool can_derive_epsilon = true;
-            
-            for (char first_symbol : production) {
-                set<char> current_first = calculate_first_of_symbol(first_symbol);
-                
-                // Add all non-epsilon symbols from current symbol's FIRST
-                for (char f : current_first) {
-                    if (f != 'e') {
-                        first_set.insert(f);
-                    }
+    // A production over interned symbols. Removed productions stay behind
+    // as tombstones so rule indexes remain stable between edits.
+    struct Rule {
+        int lhs;
+        vector<int> rhs;
+        bool alive;
+    };
+
+    SymbolPool symbols;
+    vector<Rule> rules;
+    int start_symbol = -1;
+
+    // Per symbol id
+    vector<char> is_nt;               // has been the left-hand side of a rule
+    vector<int> terminal_bit;         // bit in the terminal sets, -1 if none
+    vector<vector<int>> rules_of;     // live rules with this left-hand side
+    vector<vector<int>> used_in;      // live rules, once per occurrence on a right-hand side
+    vector<int> bit_symbol;           // terminal bit -> symbol id, bit 0 is "$"
+
+    // Analysis results, rows indexed by symbol id
+    vector<char> nullable;
+    BitMatrix first, follow;
+
+    // Edits since the last recompute()
+    vector<int> dirty;                // non-terminals whose rules changed
+    vector<int> converted;            // symbols first used as terminals, now defined
+    vector<int> edited_rules;         // rules added or removed
+    bool start_pending = false;
+
+    // Scratch: symbol id -> index in the region being solved, or -1
+    vector<int> local;
+
+    // Workers for solving independent components, null when sequential
+    unique_ptr<ThreadPool> pool;
+
+    // Regions smaller than this are not worth handing to the pool
+    static const size_t parallel_threshold = 256;
+
+    void solve(const Digraph& deps, BitMatrix& values) {
+        Components components = strongly_connected_components(deps);
+        if (pool && size_t(deps.nodes()) >= parallel_threshold) {
+            solve_union_system_parallel(deps, components, values, *pool);
+        } else {
+            solve_union_system(deps, components, values);
+        }
+    }
+
+    int symbol_id(const string& name) {
+        int id = symbols.intern(name);
+        if (id >= int(is_nt.size())) {
+            is_nt.push_back(0);
+            terminal_bit.push_back(-1);
+            rules_of.emplace_back();
+            used_in.emplace_back();
+            nullable.push_back(0);
+            local.push_back(-1);
+        }
+        return id;
+    }
+
+    void mark_dirty(int symbol) {
+        if (local[symbol] == -2) return;
+        local[symbol] = -2;
+        dirty.push_back(symbol);
+    }
+
+    // Grow the set matrices (doubling) when symbols or terminals were added
+    void grow_sets() {
+        size_t rows = first.rows(), bits = first.words() * 64;
+        size_t need_rows = symbols.size(), need_bits = bit_symbol.size();
+        if (need_rows <= rows && need_bits <= bits) return;
+
+        rows = max(need_rows, rows * 2);
+        bits = max(need_bits, bits * 2);
+        BitMatrix grown_first(rows, bits), grown_follow(rows, bits);
+        size_t copy = first.words() * sizeof(uint64_t);
+        for (size_t r = 0; r < first.rows(); ++r) {
+            if (copy == 0) break;
+            memcpy(grown_first.row(r), first.row(r), copy);
+            memcpy(grown_follow.row(r), follow.row(r), copy);
+        }
+        first = move(grown_first);
+        follow = move(grown_follow);
+    }
+
+    // Adds a symbol to the region being built if it is not there yet
+    void add_to_region(vector<int>& region, int symbol) {
+        if (local[symbol] >= 0) return;
+        local[symbol] = region.size();
+        region.push_back(symbol);
+    }
+
+    void clear_region(const vector<int>& region) {
+        for (int symbol : region) local[symbol] = -1;
+    }
+
+    // Adds FIRST(rhs[from..]) to out and returns whether that suffix is nullable
+    bool first_of_suffix(const vector<int>& rhs, size_t from, uint64_t* out) {
+        for (size_t i = from; i < rhs.size(); ++i) {
+            if (!is_nt[rhs[i]]) {
+                bits_set(out, terminal_bit[rhs[i]]);
+                return false;
+            }
+            bits_union(out, first.row(rhs[i]), first.words());
+            if (!nullable[rhs[i]]) return false;
+        }
+        return true;
+    }
+
+    // Recompute nullable and FIRST for every non-terminal that can reach an
+    // edited one through right-hand sides; everything else is an input.
+    // Returns the region, which stays marked in local[].
+    vector<int> solve_first_region(vector<int>& changed) {
+        vector<int> region;
+        for (int symbol : dirty) {
+            local[symbol] = -1;
+            add_to_region(region, symbol);
+        }
+        for (size_t i = 0; i < region.size(); ++i) {
+            for (int r : used_in[region[i]]) add_to_region(region, rules[r].lhs);
+        }
+
+        size_t words = first.words();
+        vector<char> old_nullable(region.size());
+        BitMatrix old_first(region.size(), words * 64), values(region.size(), words * 64);
+        for (size_t i = 0; i < region.size(); ++i) {
+            old_nullable[i] = nullable[region[i]];
+            memcpy(old_first.row(i), first.row(region[i]), words * sizeof(uint64_t));
+            nullable[region[i]] = 0;
+        }
+
+        // Nullable: count the symbols of each rule that are not yet known to
+        // be nullable; only non-terminals inside the region can still change
+        unordered_map<int, int> remaining;    // rule -> count
+        vector<int> worklist;
+        for (int symbol : region) {
+            for (int r : rules_of[symbol]) {
+                int count = 0;
+                for (int s : rules[r].rhs) {
+                    if (!is_nt[s] || local[s] >= 0 || !nullable[s]) count++;
                 }
-                
-                // If current symbol cannot derive epsilon, stop
-                if (current_first.find('e') == current_first.end()) {
-                    can_derive_epsilon = false;
-                    break;
+                remaining[r] = count;
+                if (count == 0 && !nullable[symbol]) {
+                    nullable[symbol] = 1;
+                    worklist.push_back(symbol);
                 }
             }
-            
-            // If entire production can derive epsilon, add epsilon to FIRST
-            if (can_derive_epsilon) {
-                first_set.insert('e');
+        }
+        while (!worklist.empty()) {
+            int symbol = worklist.back();
+            worklist.pop_back();
+            for (int r : used_in[symbol]) {
+                int lhs = rules[r].lhs;
+                if (local[lhs] < 0) continue;
+                if (--remaining[r] == 0 && !nullable[lhs]) {
+                    nullable[lhs] = 1;
+                    worklist.push_back(lhs);
+                }
             }
         }
-        
-        return first_set;
-    }
-
-    // Calculate FIRST set for a string of symbols
-    set<char> calculate_first_of_string(const string& str) {
-        set<char> first_set;
-        bool can_derive_epsilon = true;
-        
-        for (char symbol : str) {
-            set<char> current_first = calculate_first_of_symbol(symbol);
-            
-            // Add non-epsilon symbols
-            for (char f : current_first) {
-                if (f != 'e') {
-                    first_set.insert(f);
+
+        // FIRST: seeds from terminals and finished non-terminals outside the
+        // region, edges between region members, solved per component
+        vector<pair<int, int>> edges;
+        for (size_t i = 0; i < region.size(); ++i) {
+            for (int r : rules_of[region[i]]) {
+                for (int s : rules[r].rhs) {
+                    if (!is_nt[s]) {
+                        bits_set(values.row(i), terminal_bit[s]);
+                        break;
+                    }
+                    if (local[s] >= 0) {
+                        if (local[s] != int(i)) edges.push_back({int(i), local[s]});
+                    } else {
+                        bits_union(values.row(i), first.row(s), words);
+                    }
+                    if (!nullable[s]) break;
                 }
             }
-            
-            // If current symbol cannot derive epsilon, stop
-            if (current_first.find('e') == current_first.end()) {
-                can_derive_epsilon = false;
-                break;
+        }
+        Digraph deps = Digraph::from_edges(region.size(), edges);
+        solve(deps, values);
+
+        for (size_t i = 0; i < region.size(); ++i) {
+            memcpy(first.row(region[i]), values.row(i), words * sizeof(uint64_t));
+            if (nullable[region[i]] != old_nullable[i] ||
+                memcmp(values.row(i), old_first.row(i), words * sizeof(uint64_t)) != 0) {
+                changed.push_back(region[i]);
             }
         }
-        
-        // If entire string can derive epsilon, add epsilon
-        if (can_derive_epsilon) {
-            first_set.insert('e');
-        }
-        
-        return first_set;
-    }
-
-    // Calculate FOLLOW sets
-    map<char, set<char>> calculate_follow_sets() {
-        map<char, set<char>> follow_sets;
-        
-        // Add $ (end of input) to start symbol's FOLLOW
-        char start_symbol = productions.begin()->first;
-        follow_sets[start_symbol].insert('$');
-        
-        bool changed;
-        do {
-            changed = false;
-            
-            // Iterate through all productions
-            for (const auto& non_terminal : non_terminals) {
-                for (const auto& production : productions[non_terminal]) {
-                    for (size_t i = 0; i < production.length(); ++i) {
-                        if (is_non_terminal(production[i])) {
-                            // Case 1: A → αBβ, add FIRST(β) - ε to FOLLOW(B)
-                            if (i + 1 < production.length()) {
-                                set<char> first_of_next = calculate_first_of_symbol(production[i + 1]);
-                                size_t original_size = follow_sets[production[i]].size();
-                                
-                                for (char f : first_of_next) {
-                                    if (f != 'e') {
-                                        follow_sets[production[i]].insert(f);
-                                    }
-                                }
-                                
-                                if (original_size != follow_sets[production[i]].size()) {
-                                    changed = true;
-                                }
-                            }
-                            
-                            // Case 2: A → αB or A → αBβ where β can derive ε
-                            // Add FOLLOW(A) to FOLLOW(B)
-                            if (i + 1 == production.length() || 
-                                calculate_first_of_symbol(production[i + 1]).find('e') != calculate_first_of_symbol(production[i + 1]).end()) {
-                                size_t original_size = follow_sets[production[i]].size();
-                                
-                                for (char f : follow_sets[non_terminal]) {
-                                    follow_sets[production[i]].insert(f);
-                                }
-                                
-                                if (original_size != follow_sets[production[i]].size()) {
-                                    changed = true;
-                                }
-                            }
-                        }
+        return region;
+    }
+
+    // Recompute FOLLOW for the non-terminals whose inputs an edit touched,
+    // plus everything their FOLLOW sets flow into
+    void solve_follow_region(const vector<int>& first_changed, vector<int>& changed) {
+        vector<int> region;
+        auto add_rhs = [&](int r) {
+            for (int s : rules[r].rhs) {
+                if (is_nt[s]) add_to_region(region, s);
+            }
+        };
+
+        for (int r : edited_rules) add_rhs(r);
+        for (int symbol : first_changed) {
+            for (int r : used_in[symbol]) add_rhs(r);
+        }
+        for (int symbol : converted) {
+            add_to_region(region, symbol);
+            for (int r : used_in[symbol]) add_rhs(r);
+        }
+        if (start_pending) add_to_region(region, start_symbol);
+
+        // FOLLOW(A) flows into FOLLOW(B) for A → αBβ with β nullable
+        for (size_t i = 0; i < region.size(); ++i) {
+            for (int r : rules_of[region[i]]) {
+                const vector<int>& rhs = rules[r].rhs;
+                for (size_t pos = rhs.size(); pos-- > 0;) {
+                    if (!is_nt[rhs[pos]]) break;
+                    add_to_region(region, rhs[pos]);
+                    if (!nullable[rhs[pos]]) break;
+                }
+            }
+        }
+
+        size_t words = follow.words();
+        BitMatrix values(region.size(), words * 64);
+        vector<pair<int, int>> edges;
+        for (size_t i = 0; i < region.size(); ++i) {
+            int symbol = region[i];
+            uint64_t* row = values.row(i);
+            if (symbol == start_symbol) bits_set(row, 0);
+
+            const vector<int>& uses = used_in[symbol];
+            for (size_t u = 0; u < uses.size(); ++u) {
+                if (u > 0 && uses[u] == uses[u - 1]) continue;   // same rule, already scanned
+                const Rule& rule = rules[uses[u]];
+                for (size_t pos = 0; pos < rule.rhs.size(); ++pos) {
+                    if (rule.rhs[pos] != symbol || !first_of_suffix(rule.rhs, pos + 1, row)) continue;
+                    if (local[rule.lhs] >= 0) {
+                        if (rule.lhs != symbol) edges.push_back({int(i), local[rule.lhs]});
+                    } else {
+                        bits_union(row, follow.row(rule.lhs), words);
                     }
                 }
             }
-        } while (changed);
-        
-        return follow_sets;
+        }
+        Digraph deps = Digraph::from_edges(region.size(), edges);
+        solve(deps, values);
+
+        for (size_t i = 0; i < region.size(); ++i) {
+            uint64_t* row = follow.row(region[i]);
+            if (memcmp(row, values.row(i), words * sizeof(uint64_t)) != 0) {
+                memcpy(row, values.row(i), words * sizeof(uint64_t));
+                changed.push_back(region[i]);
+            }
+        }
+        clear_region(region);
+    }
+
+    vector<string> set_names(BitMatrix& sets, const string& non_terminal) {
+        recompute();
+        vector<string> names;
+        int symbol = symbols.find(non_terminal);
+        if (symbol < 0 || !is_nt[symbol]) return names;
+        bits_for_each(sets.row(symbol), sets.words(), [&](int bit) {
+            names.push_back(symbols.name(bit_symbol[bit]));
+        });
+        return names;
+    }
+
+    // Print one terminal set, with ε last if requested
+    void print_set(const uint64_t* row, bool with_epsilon) {
+        cout << "{ ";
+        bits_for_each(row, first.words(), [&](int bit) {
+            cout << symbols.name(bit_symbol[bit]) << " ";
+        });
+        if (with_epsilon) cout << "ε ";
+        cout << "}\n";
     }
 
 public:
-    // Add a production to the grammar
-    void add_production(char non_terminal, const string& production) {
-        productions[non_terminal].push_back(production);
-        non_terminals.insert(non_terminal);
-        
-        // Identify terminals
-        for (char symbol : production) {
-            if (!is_non_terminal(symbol) && symbol != 'e') {
-                terminals.insert(symbol);
+    FirstFollowCalculator() {
+        int end_marker = symbol_id("$");
+        terminal_bit[end_marker] = 0;
+        bit_symbol.push_back(end_marker);
+    }
+
+    // Solve independent components on `workers` threads (1 = sequential,
+    // 0 = one per hardware thread). Results do not depend on the setting.
+    void set_workers(unsigned workers) {
+        if (workers == 1) {
+            pool.reset();
+        } else {
+            pool.reset(new ThreadPool(workers));
+        }
+    }
+
+    // Add a production to the grammar; symbols are separated by whitespace.
+    // "ε" or an empty string is the empty production.
+    void add_production(const string& non_terminal, const string& production) {
+        int lhs = symbol_id(non_terminal);
+        if (!is_nt[lhs]) {
+            is_nt[lhs] = 1;
+            if (terminal_bit[lhs] >= 0) converted.push_back(lhs);
+        }
+        if (start_symbol < 0) {
+            start_symbol = lhs;
+            start_pending = true;
+        }
+
+        Rule rule{lhs, {}, true};
+        istringstream in(production);
+        string name;
+        while (in >> name) {
+            if (name == "ε") continue;
+            int symbol = symbol_id(name);
+            if (!is_nt[symbol] && terminal_bit[symbol] < 0) {
+                terminal_bit[symbol] = bit_symbol.size();
+                bit_symbol.push_back(symbol);
+            }
+            rule.rhs.push_back(symbol);
+        }
+
+        int r = rules.size();
+        rules.push_back(move(rule));
+        rules_of[lhs].push_back(r);
+        for (int symbol : rules[r].rhs) used_in[symbol].push_back(r);
+        edited_rules.push_back(r);
+        mark_dirty(lhs);
+    }
+
+    // Remove one production previously added with the same text.
+    // Returns false if there is no such production.
+    bool remove_production(const string& non_terminal, const string& production) {
+        int lhs = symbols.find(non_terminal);
+        if (lhs < 0 || !is_nt[lhs]) return false;
+
+        vector<int> rhs;
+        istringstream in(production);
+        string name;
+        while (in >> name) {
+            if (name == "ε") continue;
+            int symbol = symbols.find(name);
+            if (symbol < 0) return false;
+            rhs.push_back(symbol);
+        }
+
+        for (int r : rules_of[lhs]) {
+            if (rules[r].rhs != rhs) continue;
+            rules[r].alive = false;
+            rules_of[lhs].erase(find(rules_of[lhs].begin(), rules_of[lhs].end(), r));
+            for (int symbol : rhs) {
+                vector<int>& uses = used_in[symbol];
+                uses.erase(remove(uses.begin(), uses.end(), r), uses.end());
             }
+            edited_rules.push_back(r);
+            mark_dirty(lhs);
+            return true;
         }
+        return false;
+    }
+
+    // Bring FIRST and FOLLOW up to date with the edits made since the last
+    // call. Only sets reachable from an edit are recomputed.
+    SetChanges recompute() {
+        SetChanges changes;
+        if (dirty.empty() && converted.empty()) return changes;
+        for (int symbol : converted) mark_dirty(symbol);
+        grow_sets();
+
+        vector<int> first_changed, follow_changed;
+        vector<int> region = solve_first_region(first_changed);
+        clear_region(region);
+        solve_follow_region(first_changed, follow_changed);
+
+        for (int symbol : first_changed) changes.first.push_back(symbols.name(symbol));
+        for (int symbol : follow_changed) changes.follow.push_back(symbols.name(symbol));
+
+        dirty.clear();
+        converted.clear();
+        edited_rules.clear();
+        start_pending = false;
+        return changes;
+    }
+
+    // Names of the terminals in FIRST/FOLLOW of a non-terminal, in the
+    // order the terminals were first seen; empty if it is not defined
+    vector<string> first_set(const string& non_terminal) { return set_names(first, non_terminal); }
+    vector<string> follow_set(const string& non_terminal) { return set_names(follow, non_terminal); }
+
+    bool derives_epsilon(const string& non_terminal) {
+        recompute();
+        int symbol = symbols.find(non_terminal);
+        return symbol >= 0 && is_nt[symbol] && nullable[symbol];
     }
 
     // Calculate and print FIRST sets
     void print_first_sets() {
+        recompute();
         cout << "FIRST SETS:\n";
-        for (char non_terminal : non_terminals) {
-            cout << "FIRST(" << non_terminal << ") = { ";
-            set<char> first_set = calculate_first_of_symbol(non_terminal);
-            for (char f : first_set) {
-                cout << (f == 'e' ? "ε" : string(1, f)) << " ";
-            }
-            cout << "}\n";
+        for (int symbol = 0; symbol < symbols.size(); ++symbol) {
+            if (!is_nt[symbol]) continue;
+            cout << "FIRST(" << symbols.name(symbol) << ") = ";
+            print_set(first.row(symbol), nullable[symbol]);
         }
     }
 
     // Calculate and print FOLLOW sets
     void print_follow_sets() {
-        map<char, set<char>> follow_sets = calculate_follow_sets();
-        
+        recompute();
         cout << "\nFOLLOW SETS:\n";
-        for (char non_terminal : non_terminals) {
-            cout << "FOLLOW(" << non_terminal << ") = { ";
-            for (char f : follow_sets[non_terminal]) {
-                cout << (f == 'e' ? "ε" : string(1, f)) << " ";
-            }
-            cout << "}\n";
+        for (int symbol = 0; symbol < symbols.size(); ++symbol) {
+            if (!is_nt[symbol]) continue;
+            cout << "FOLLOW(" << symbols.name(symbol) << ") = ";
+            print_set(follow.row(symbol), false);
         }
     }
+
+    // Print which sets the last recompute() changed
+    static void print_changes(const SetChanges& changes) {
+        cout << "\nChanged FIRST sets: { ";
+        for (const string& name : changes.first) cout << name << " ";
+        cout << "}\nChanged FOLLOW sets: { ";
+        for (const string& name : changes.follow) cout << name << " ";
+        cout << "}\n";
+    }
 };
 
+#ifndef GRAMMAR_BENCH
 int main() {
     FirstFollowCalculator calculator;
 
@@ -203,12 +457,12 @@ int main() {
     // T → F * T | F
     // F → ( E ) | id
 
-    calculator.add_production('E', "T+E");
-    calculator.add_production('E', "T");
-    calculator.add_production('T', "F*T");
-    calculator.add_production('T', "F");
-    calculator.add_production('F', "(E)");
-    calculator.add_production('F', "id");
+    calculator.add_production("E", "T + E");
+    calculator.add_production("E", "T");
+    calculator.add_production("T", "F * T");
+    calculator.add_production("T", "F");
+    calculator.add_production("F", "( E )");
+    calculator.add_production("F", "id");
 
     // Calculate and print FIRST sets
     calculator.print_first_sets();
@@ -216,5 +470,15 @@ int main() {
     // Calculate and print FOLLOW sets
     calculator.print_follow_sets();
 
+    // Edit the grammar and recompute only what the edit reaches:
+    // F → - F adds '-' to FIRST(F), FIRST(T) and FIRST(E)
+    calculator.add_production("F", "- F");
+    FirstFollowCalculator::print_changes(calculator.recompute());
+
+    // Removing it again restores the original sets
+    calculator.remove_production("F", "- F");
+    FirstFollowCalculator::print_changes(calculator.recompute());
+
     return 0;
-}
\ No newline at end of file
+}
+#endif
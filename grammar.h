@@ -0,0 +1,662 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "thread_pool.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Shared grammar core used by first-follow.cpp, ll.cpp and slr.cpp.
+//
+// Symbols are interned into dense integer ids, so a multi-character
+// terminal such as "id" is one symbol. Terminal sets (FIRST, FOLLOW,
+// predict sets) are fixed-width bit rows whose unions run a word at a time.
+
+// Maps symbol names to dense ids
+class SymbolPool {
+    std::unordered_map<std::string, int> ids;
+    std::vector<std::string> names;
+
+public:
+    int intern(const std::string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        int id = names.size();
+        ids.emplace(name, id);
+        names.push_back(name);
+        return id;
+    }
+
+    // Returns -1 if the name was never interned
+    int find(const std::string& name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? -1 : it->second;
+    }
+
+    const std::string& name(int id) const { return names[id]; }
+    int size() const { return names.size(); }
+};
+
+// ---------------------------------------------------------------------------
+// Bit rows
+// ---------------------------------------------------------------------------
+
+inline size_t words_for(size_t bits) { return (bits + 63) / 64; }
+
+inline void bits_set(uint64_t* row, int bit) { row[bit >> 6] |= uint64_t(1) << (bit & 63); }
+
+inline bool bits_test(const uint64_t* row, int bit) { return (row[bit >> 6] >> (bit & 63)) & 1; }
+
+// dst |= src, returns true if dst grew
+inline bool bits_union(uint64_t* dst, const uint64_t* src, size_t words) {
+    size_t i = 0;
+    uint64_t grew = 0;
+#if defined(__AVX2__)
+    __m256i grew_v = _mm256_setzero_si256();
+    for (; i + 4 <= words; i += 4) {
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i merged = _mm256_or_si256(d, s);
+        grew_v = _mm256_or_si256(grew_v, _mm256_xor_si256(merged, d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), merged);
+    }
+    grew = !_mm256_testz_si256(grew_v, grew_v);
+#endif
+    for (; i < words; ++i) {
+        uint64_t merged = dst[i] | src[i];
+        grew |= merged ^ dst[i];
+        dst[i] = merged;
+    }
+    return grew != 0;
+}
+
+inline bool bits_intersect(const uint64_t* a, const uint64_t* b, size_t words) {
+    for (size_t i = 0; i < words; ++i) {
+        if (a[i] & b[i]) return true;
+    }
+    return false;
+}
+
+inline bool bits_empty(const uint64_t* row, size_t words) {
+    for (size_t i = 0; i < words; ++i) {
+        if (row[i]) return false;
+    }
+    return true;
+}
+
+inline size_t bits_count(const uint64_t* row, size_t words) {
+    size_t count = 0;
+    for (size_t i = 0; i < words; ++i) count += __builtin_popcountll(row[i]);
+    return count;
+}
+
+// Calls f(bit) for every set bit in ascending order
+template <class F>
+inline void bits_for_each(const uint64_t* row, size_t words, F f) {
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t word = row[i];
+        while (word) {
+            f(int(i * 64 + __builtin_ctzll(word)));
+            word &= word - 1;
+        }
+    }
+}
+
+// A dense array of equally sized bit rows in one allocation
+class BitMatrix {
+    size_t row_count = 0;
+    size_t row_words = 0;
+    std::vector<uint64_t> data;
+
+public:
+    BitMatrix() = default;
+    BitMatrix(size_t rows, size_t bits)
+        : row_count(rows), row_words(words_for(bits)), data(rows * row_words) {}
+
+    uint64_t* row(size_t r) { return data.data() + r * row_words; }
+    const uint64_t* row(size_t r) const { return data.data() + r * row_words; }
+    size_t rows() const { return row_count; }
+    size_t words() const { return row_words; }
+    size_t bytes() const { return data.size() * sizeof(uint64_t); }
+
+    bool operator==(const BitMatrix& other) const {
+        return row_words == other.row_words && data == other.data;
+    }
+    bool operator!=(const BitMatrix& other) const { return !(*this == other); }
+};
+
+// ---------------------------------------------------------------------------
+// Grammar
+// ---------------------------------------------------------------------------
+
+struct Production {
+    int lhs;                // symbol id of the non-terminal
+    std::vector<int> rhs;   // symbol ids, empty for ε
+};
+
+// A context-free grammar over interned symbols.
+// A symbol is a non-terminal exactly when it has a production; everything
+// else is a terminal. The start symbol is the left-hand side of the first
+// production. Call finalize() after the last edit to build the dense indexes.
+class Grammar {
+public:
+    SymbolPool symbols;
+    std::vector<Production> productions;
+
+    // Built by finalize()
+    std::vector<int> nonterminals;           // dense non-terminal index -> symbol id
+    std::vector<int> terminals;              // dense terminal index -> symbol id, "$" is 0
+    std::vector<int> nt_of;                  // symbol id -> non-terminal index or -1
+    std::vector<int> term_of;                // symbol id -> terminal index or -1
+    std::vector<std::vector<int>> rules_of;  // non-terminal index -> production indices
+    int start = 0;                           // non-terminal index of the start symbol
+    int end_marker;                          // symbol id of "$"
+
+    Grammar() { end_marker = symbols.intern("$"); }
+
+    // Adds lhs → rhs where rhs is a whitespace separated list of symbols.
+    // "ε", "eps" or an empty string stand for the empty production.
+    int add_production(const std::string& lhs, const std::string& rhs) {
+        Production production;
+        production.lhs = symbols.intern(lhs);
+        std::istringstream in(rhs);
+        std::string symbol;
+        while (in >> symbol) {
+            if (symbol == "ε" || symbol == "eps") continue;
+            production.rhs.push_back(symbols.intern(symbol));
+        }
+        productions.push_back(std::move(production));
+        finalized = false;
+        return productions.size() - 1;
+    }
+
+    // Parses one rule line such as "E -> T X | ε". Returns false if the
+    // line has no "->".
+    bool add_rule(const std::string& line) {
+        size_t arrow = line.find("->");
+        if (arrow == std::string::npos) return false;
+
+        std::istringstream lhs_in(line.substr(0, arrow));
+        std::string lhs;
+        if (!(lhs_in >> lhs)) return false;
+
+        std::string rhs = line.substr(arrow + 2);
+        size_t bar;
+        while ((bar = rhs.find('|')) != std::string::npos) {
+            add_production(lhs, rhs.substr(0, bar));
+            rhs.erase(0, bar + 1);
+        }
+        add_production(lhs, rhs);
+        return true;
+    }
+
+    void finalize() {
+        if (finalized) return;
+        int count = symbols.size();
+        nt_of.assign(count, -1);
+        term_of.assign(count, -1);
+        nonterminals.clear();
+        terminals.clear();
+
+        for (const Production& production : productions) {
+            if (nt_of[production.lhs] < 0) {
+                nt_of[production.lhs] = nonterminals.size();
+                nonterminals.push_back(production.lhs);
+            }
+        }
+
+        term_of[end_marker] = 0;
+        terminals.push_back(end_marker);
+        for (const Production& production : productions) {
+            for (int symbol : production.rhs) {
+                if (nt_of[symbol] < 0 && term_of[symbol] < 0) {
+                    term_of[symbol] = terminals.size();
+                    terminals.push_back(symbol);
+                }
+            }
+        }
+
+        rules_of.assign(nonterminals.size(), std::vector<int>());
+        for (size_t p = 0; p < productions.size(); ++p) {
+            rules_of[nt_of[productions[p].lhs]].push_back(p);
+        }
+        start = 0;
+        finalized = true;
+    }
+
+    bool is_nonterminal(int symbol) const { return nt_of[symbol] >= 0; }
+    const std::string& name(int symbol) const { return symbols.name(symbol); }
+
+    // Right-hand side as text, "ε" when empty
+    std::string rhs_text(int production) const {
+        const std::vector<int>& rhs = productions[production].rhs;
+        if (rhs.empty()) return "ε";
+        std::string text;
+        for (size_t i = 0; i < rhs.size(); ++i) {
+            if (i) text += ' ';
+            text += name(rhs[i]);
+        }
+        return text;
+    }
+
+private:
+    bool finalized = false;
+};
+
+// ---------------------------------------------------------------------------
+// Dependency graphs
+// ---------------------------------------------------------------------------
+
+// A directed graph over dense node ids in compressed sparse row form
+struct Digraph {
+    std::vector<int> offsets;   // node -> first edge, size nodes + 1
+    std::vector<int> targets;
+
+    int nodes() const { return int(offsets.size()) - 1; }
+
+    static Digraph from_edges(int nodes, const std::vector<std::pair<int, int>>& edges) {
+        Digraph graph;
+        graph.offsets.assign(nodes + 1, 0);
+        for (const auto& edge : edges) graph.offsets[edge.first + 1]++;
+        for (int n = 0; n < nodes; ++n) graph.offsets[n + 1] += graph.offsets[n];
+        graph.targets.resize(edges.size());
+        std::vector<int> fill(graph.offsets.begin(), graph.offsets.end() - 1);
+        for (const auto& edge : edges) graph.targets[fill[edge.first]++] = edge.second;
+        return graph;
+    }
+};
+
+// Strongly connected components, numbered in the order Tarjan's algorithm
+// emits them: every edge leads to a component with an equal or lower number
+struct Components {
+    std::vector<int> component_of;   // node -> component
+    std::vector<int> offsets;        // component -> first member, size count + 1
+    std::vector<int> members;
+
+    int count() const { return int(offsets.size()) - 1; }
+};
+
+inline Components strongly_connected_components(const Digraph& graph) {
+    int n = graph.nodes();
+    Components result;
+    result.component_of.assign(n, -1);
+    result.offsets.push_back(0);
+
+    std::vector<int> index_of(n, -1), low_link(n, 0);
+    std::vector<int> scc_stack;
+    std::vector<char> on_stack(n, 0);
+    std::vector<std::pair<int, int>> call_stack;   // (node, next edge)
+    int next_index = 0;
+
+    // Explicit call stack so deep grammars cannot overflow the C++ stack
+    for (int root = 0; root < n; ++root) {
+        if (index_of[root] >= 0) continue;
+        call_stack.push_back({root, graph.offsets[root]});
+        index_of[root] = low_link[root] = next_index++;
+        scc_stack.push_back(root);
+        on_stack[root] = 1;
+
+        while (!call_stack.empty()) {
+            int node = call_stack.back().first;
+            int& edge = call_stack.back().second;
+
+            if (edge < graph.offsets[node + 1]) {
+                int next = graph.targets[edge++];
+                if (index_of[next] < 0) {
+                    index_of[next] = low_link[next] = next_index++;
+                    scc_stack.push_back(next);
+                    on_stack[next] = 1;
+                    call_stack.push_back({next, graph.offsets[next]});
+                } else if (on_stack[next]) {
+                    low_link[node] = std::min(low_link[node], index_of[next]);
+                }
+                continue;
+            }
+
+            call_stack.pop_back();
+            if (!call_stack.empty()) {
+                int parent = call_stack.back().first;
+                low_link[parent] = std::min(low_link[parent], low_link[node]);
+            }
+            if (low_link[node] != index_of[node]) continue;
+
+            int component = result.count();
+            int member;
+            do {
+                member = scc_stack.back();
+                scc_stack.pop_back();
+                on_stack[member] = 0;
+                result.component_of[member] = component;
+                result.members.push_back(member);
+            } while (member != node);
+            result.offsets.push_back(result.members.size());
+        }
+    }
+    return result;
+}
+
+// Solves values(x) = seed(x) ∪ values(y) for every edge x → y, where
+// values holds the seeds on entry. Members of a component end up with the
+// same set, so each component costs one union per member and outgoing edge.
+inline void solve_component(const Digraph& deps, const Components& components, int c, BitMatrix& values) {
+    size_t words = values.words();
+    const int* first = components.members.data() + components.offsets[c];
+    const int* last = components.members.data() + components.offsets[c + 1];
+    uint64_t* acc = values.row(*first);
+
+    for (const int* m = first; m != last; ++m) {
+        if (m != first) bits_union(acc, values.row(*m), words);
+        for (int e = deps.offsets[*m]; e < deps.offsets[*m + 1]; ++e) {
+            int target = deps.targets[e];
+            if (components.component_of[target] != c) {
+                bits_union(acc, values.row(target), words);
+            }
+        }
+    }
+    for (const int* m = first + 1; m < last; ++m) {
+        std::memcpy(values.row(*m), acc, words * sizeof(uint64_t));
+    }
+}
+
+inline void solve_union_system(const Digraph& deps, const Components& components, BitMatrix& values) {
+    for (int c = 0; c < components.count(); ++c) {
+        solve_component(deps, components, c, values);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Analysis
+// ---------------------------------------------------------------------------
+
+// Nullable flags and FIRST/FOLLOW rows per non-terminal index. Bits are
+// terminal indexes; bit 0 ("$") only ever appears in FOLLOW sets.
+struct GrammarAnalysis {
+    std::vector<char> nullable;
+    BitMatrix first;
+    BitMatrix follow;
+};
+
+// Nullable non-terminals with a counting worklist: each production counts
+// the symbols not yet known to be nullable, and its left-hand side becomes
+// nullable when the count reaches zero.
+inline std::vector<char> compute_nullable(const Grammar& g) {
+    size_t nts = g.nonterminals.size();
+    std::vector<char> nullable(nts, 0);
+    std::vector<int> remaining(g.productions.size());
+    std::vector<std::vector<int>> used_in(nts);
+    std::vector<int> worklist;
+
+    for (size_t p = 0; p < g.productions.size(); ++p) {
+        const Production& production = g.productions[p];
+        remaining[p] = production.rhs.size();
+        for (int symbol : production.rhs) {
+            if (g.nt_of[symbol] >= 0) used_in[g.nt_of[symbol]].push_back(p);
+        }
+        int lhs = g.nt_of[production.lhs];
+        if (remaining[p] == 0 && !nullable[lhs]) {
+            nullable[lhs] = 1;
+            worklist.push_back(lhs);
+        }
+    }
+
+    // Terminals never become nullable, so their counts never reach zero
+    while (!worklist.empty()) {
+        int nt = worklist.back();
+        worklist.pop_back();
+        for (int p : used_in[nt]) {
+            int lhs = g.nt_of[g.productions[p].lhs];
+            if (--remaining[p] == 0 && !nullable[lhs]) {
+                nullable[lhs] = 1;
+                worklist.push_back(lhs);
+            }
+        }
+    }
+    return nullable;
+}
+
+// Seeds and dependency graph for FIRST: FIRST(A) depends on FIRST(B) when B
+// appears in a production of A behind a nullable prefix
+inline Digraph first_dependencies(const Grammar& g, const std::vector<char>& nullable, BitMatrix& first) {
+    std::vector<std::pair<int, int>> edges;
+    for (const Production& production : g.productions) {
+        int lhs = g.nt_of[production.lhs];
+        for (int symbol : production.rhs) {
+            int nt = g.nt_of[symbol];
+            if (nt < 0) {
+                bits_set(first.row(lhs), g.term_of[symbol]);
+                break;
+            }
+            if (nt != lhs) edges.push_back({lhs, nt});
+            if (!nullable[nt]) break;
+        }
+    }
+    return Digraph::from_edges(g.nonterminals.size(), edges);
+}
+
+// Seeds and dependency graph for FOLLOW: for A → αBβ, FIRST(β) seeds
+// FOLLOW(B), and FOLLOW(B) depends on FOLLOW(A) when β is nullable.
+// Each right-hand side is walked backwards with a running FIRST(β).
+inline Digraph follow_dependencies(const Grammar& g, const GrammarAnalysis& a, BitMatrix& follow) {
+    size_t words = follow.words();
+    std::vector<uint64_t> suffix(words);
+    std::vector<std::pair<int, int>> edges;
+
+    bits_set(follow.row(g.start), 0);
+    for (const Production& production : g.productions) {
+        int lhs = g.nt_of[production.lhs];
+        std::fill(suffix.begin(), suffix.end(), 0);
+        bool suffix_nullable = true;
+
+        for (size_t i = production.rhs.size(); i-- > 0;) {
+            int symbol = production.rhs[i];
+            int nt = g.nt_of[symbol];
+            if (nt < 0) {
+                std::fill(suffix.begin(), suffix.end(), 0);
+                bits_set(suffix.data(), g.term_of[symbol]);
+                suffix_nullable = false;
+                continue;
+            }
+
+            bits_union(follow.row(nt), suffix.data(), words);
+            if (suffix_nullable && nt != lhs) edges.push_back({nt, lhs});
+
+            if (a.nullable[nt]) {
+                bits_union(suffix.data(), a.first.row(nt), words);
+            } else {
+                std::memcpy(suffix.data(), a.first.row(nt), words * sizeof(uint64_t));
+                suffix_nullable = false;
+            }
+        }
+    }
+    return Digraph::from_edges(g.nonterminals.size(), edges);
+}
+
+// Computes nullable, FIRST and FOLLOW for a finalized grammar. Both set
+// families are solved per strongly connected component in dependency
+// order, so the cost is linear in grammar size times the row width.
+inline GrammarAnalysis analyze(const Grammar& g) {
+    size_t nts = g.nonterminals.size();
+    size_t terms = g.terminals.size();
+    GrammarAnalysis a;
+
+    a.nullable = compute_nullable(g);
+
+    a.first = BitMatrix(nts, terms);
+    Digraph first_deps = first_dependencies(g, a.nullable, a.first);
+    solve_union_system(first_deps, strongly_connected_components(first_deps), a.first);
+
+    a.follow = BitMatrix(nts, terms);
+    if (nts > 0) {
+        Digraph follow_deps = follow_dependencies(g, a, a.follow);
+        solve_union_system(follow_deps, strongly_connected_components(follow_deps), a.follow);
+    }
+    return a;
+}
+
+// Adds FIRST(symbols) to out and returns whether the whole sequence is nullable
+inline bool first_of_sequence(const Grammar& g, const GrammarAnalysis& a,
+                              const int* begin, const int* end, uint64_t* out) {
+    for (const int* s = begin; s != end; ++s) {
+        int nt = g.nt_of[*s];
+        if (nt < 0) {
+            bits_set(out, g.term_of[*s]);
+            return false;
+        }
+        bits_union(out, a.first.row(nt), a.first.words());
+        if (!a.nullable[nt]) return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Parallel analysis
+// ---------------------------------------------------------------------------
+
+// Same result as solve_union_system, with independent components solved
+// concurrently. A component becomes ready when every component it depends
+// on is solved; a worker that finishes one continues with a dependent that
+// became ready, and hands any others to the pool.
+inline void solve_union_system_parallel(const Digraph& deps, const Components& components,
+                                        BitMatrix& values, ThreadPool& pool) {
+    int count = components.count();
+    if (pool.size() <= 1 || count < 2) {
+        solve_union_system(deps, components, values);
+        return;
+    }
+
+    // Condensation graph: dependents of each component, and how many
+    // distinct components each one still waits for
+    std::vector<std::pair<int, int>> edges;
+    std::vector<int> seen(count, -1);
+    std::unique_ptr<std::atomic<int>[]> pending(new std::atomic<int>[count]);
+    for (int c = 0; c < count; ++c) {
+        int waits = 0;
+        for (int i = components.offsets[c]; i < components.offsets[c + 1]; ++i) {
+            int member = components.members[i];
+            for (int e = deps.offsets[member]; e < deps.offsets[member + 1]; ++e) {
+                int target = components.component_of[deps.targets[e]];
+                if (target == c || seen[target] == c) continue;
+                seen[target] = c;
+                edges.push_back({target, c});
+                waits++;
+            }
+        }
+        pending[c].store(waits, std::memory_order_relaxed);
+    }
+    Digraph dependents = Digraph::from_edges(count, edges);
+
+    std::function<void(int)> run = [&](int c) {
+        while (c >= 0) {
+            solve_component(deps, components, c, values);
+            int next = -1;
+            for (int e = dependents.offsets[c]; e < dependents.offsets[c + 1]; ++e) {
+                int d = dependents.targets[e];
+                if (pending[d].fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+                if (next < 0) {
+                    next = d;
+                } else {
+                    pool.submit([&run, d] { run(d); });
+                }
+            }
+            c = next;
+        }
+    };
+
+    std::vector<int> roots;
+    for (int c = 0; c < count; ++c) {
+        if (pending[c].load(std::memory_order_relaxed) == 0) roots.push_back(c);
+    }
+    // Roots are handed out in slices so that grammars with thousands of
+    // independent non-terminals do not pay one task each
+    size_t slice = std::max<size_t>(1, roots.size() / (pool.size() * 4));
+    for (size_t begin = 0; begin < roots.size(); begin += slice) {
+        size_t end = std::min(roots.size(), begin + slice);
+        pool.submit([&, begin, end] {
+            for (size_t i = begin; i < end; ++i) run(roots[i]);
+        });
+    }
+    pool.wait();
+}
+
+// analyze() on a thread pool. Seeds are built per non-terminal, so each
+// worker only writes its own rows, and both union systems are solved with
+// solve_union_system_parallel. The result is identical to analyze().
+inline GrammarAnalysis analyze_parallel(const Grammar& g, ThreadPool& pool) {
+    size_t nts = g.nonterminals.size();
+    size_t terms = g.terminals.size();
+    if (pool.size() <= 1 || nts == 0) return analyze(g);
+
+    GrammarAnalysis a;
+    a.nullable = compute_nullable(g);
+    a.first = BitMatrix(nts, terms);
+    a.follow = BitMatrix(nts, terms);
+    size_t chunks = pool.size() * 4;
+
+    // Every production is seeded by the worker that owns its left-hand side
+    std::vector<std::vector<std::pair<int, int>>> chunk_edges(chunks);
+    pool.parallel_for(nts, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t lhs = begin; lhs < end; ++lhs) {
+            for (int p : g.rules_of[lhs]) {
+                for (int symbol : g.productions[p].rhs) {
+                    int nt = g.nt_of[symbol];
+                    if (nt < 0) {
+                        bits_set(a.first.row(lhs), g.term_of[symbol]);
+                        break;
+                    }
+                    if (nt != int(lhs)) chunk_edges[chunk].push_back({int(lhs), nt});
+                    if (!a.nullable[nt]) break;
+                }
+            }
+        }
+    }, chunks);
+    std::vector<std::pair<int, int>> edges;
+    for (auto& part : chunk_edges) {
+        edges.insert(edges.end(), part.begin(), part.end());
+        part.clear();
+    }
+    Digraph first_deps = Digraph::from_edges(nts, edges);
+    solve_union_system_parallel(first_deps, strongly_connected_components(first_deps), a.first, pool);
+
+    // (production, position) of every occurrence of a non-terminal, so
+    // each FOLLOW row has exactly one writer
+    std::vector<std::vector<std::pair<int, int>>> occurrences(nts);
+    for (size_t p = 0; p < g.productions.size(); ++p) {
+        const std::vector<int>& rhs = g.productions[p].rhs;
+        for (size_t pos = 0; pos < rhs.size(); ++pos) {
+            int nt = g.nt_of[rhs[pos]];
+            if (nt >= 0) occurrences[nt].push_back({int(p), int(pos)});
+        }
+    }
+
+    bits_set(a.follow.row(g.start), 0);
+    pool.parallel_for(nts, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t nt = begin; nt < end; ++nt) {
+            uint64_t* row = a.follow.row(nt);
+            for (const auto& occurrence : occurrences[nt]) {
+                const Production& production = g.productions[occurrence.first];
+                const int* rest = production.rhs.data() + occurrence.second + 1;
+                const int* rhs_end = production.rhs.data() + production.rhs.size();
+                int lhs = g.nt_of[production.lhs];
+                if (first_of_sequence(g, a, rest, rhs_end, row) && lhs != int(nt)) {
+                    chunk_edges[chunk].push_back({int(nt), lhs});
+                }
+            }
+        }
+    }, chunks);
+    edges.clear();
+    for (auto& part : chunk_edges) edges.insert(edges.end(), part.begin(), part.end());
+    Digraph follow_deps = Digraph::from_edges(nts, edges);
+    solve_union_system_parallel(follow_deps, strongly_connected_components(follow_deps), a.follow, pool);
+    return a;
+}
+
+#endif
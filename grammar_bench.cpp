@@ -0,0 +1,441 @@
+// Benchmark and cross-check for the FIRST/FOLLOW implementations:
+// first-follow.cpp, ll.cpp and slr.cpp, plus the grammar.h core, followed
+// by the LR table builders of lr.h (SLR(1) and LALR(1)) on the same grammar.
+//
+// A seeded generator builds a random grammar; every implementation
+// analyzes it from the grammar text, and the results are compared against
+// grammar.h's analyze(). Reported per implementation: best wall time over
+// the runs, heap allocations and peak heap bytes of one run. Any mismatch,
+// including packed LR tables that disagree with the dense ones, makes the
+// exit status 1.
+//
+//   g++ -std=c++17 -O2 -pthread -o grammar_bench grammar_bench.cpp
+//   ./grammar_bench --nonterminals 2000 --terminals 200 --epsilon 0.2 --seed 7
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <new>
+#include <cstdlib>
+#include <malloc.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Heap accounting: every operator new/delete goes through these counters
+// ---------------------------------------------------------------------------
+
+static atomic<size_t> allocation_count{0};
+static atomic<size_t> live_bytes{0};
+static atomic<size_t> peak_bytes{0};
+
+static void* counted_alloc(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    size_t usable = malloc_usable_size(p);
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    size_t live = live_bytes.fetch_add(usable, memory_order_relaxed) + usable;
+    size_t peak = peak_bytes.load(memory_order_relaxed);
+    while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {}
+    return p;
+}
+
+static void counted_free(void* p) {
+    if (!p) return;
+    live_bytes.fetch_sub(malloc_usable_size(p), memory_order_relaxed);
+    free(p);
+}
+
+void* operator new(size_t size) { return counted_alloc(size); }
+void* operator new[](size_t size) { return counted_alloc(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    try { return counted_alloc(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    try { return counted_alloc(size); } catch (...) { return nullptr; }
+}
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+
+// ---------------------------------------------------------------------------
+// The implementations, each program compiled without its main()
+// ---------------------------------------------------------------------------
+
+#define GRAMMAR_BENCH
+#include "first-follow.cpp"
+#include "table_file.h"   // headers of ll.cpp and slr.cpp, kept outside their namespaces
+#include "lr.h"
+#include "table_pack.h"
+#include "lr_parser.h"
+
+namespace ll {
+#include "ll.cpp"
+}
+
+namespace slr {
+#include "slr.cpp"
+}
+
+// ---------------------------------------------------------------------------
+// Grammar generator
+// ---------------------------------------------------------------------------
+
+struct GeneratorOptions {
+    int nonterminals = 500;
+    int terminals = 50;          // terminal alphabet size
+    int alternatives = 3;        // maximum productions per non-terminal
+    int rule_length = 5;         // maximum right-hand side length
+    double terminal_ratio = 0.4; // chance that a right-hand side symbol is a terminal
+    double epsilon = 0.2;        // chance that a non-terminal gets an ε production
+    double left_recursion = 0.05;// chance that a non-terminal gets A → A α
+    double back_edges = 0.1;     // chance that a reference may point backwards (cycles)
+    unsigned seed = 1;
+};
+
+typedef vector<pair<string, string>> GrammarText;   // (lhs, rhs) per production
+
+GrammarText generate_grammar(const GeneratorOptions& options) {
+    mt19937 rng(options.seed);
+    uniform_real_distribution<double> chance(0.0, 1.0);
+    int n = max(1, options.nonterminals);
+    auto nonterminal = [](int i) { return "N" + to_string(i); };
+    auto terminal = [&]() { return "t" + to_string(rng() % max(1, options.terminals)); };
+
+    GrammarText grammar;
+    for (int i = 0; i < n; ++i) {
+        // References mostly point forward, so the grammar is a DAG of small
+        // components with a controllable number of cycles
+        auto reference = [&]() {
+            if (i + 1 >= n || chance(rng) < options.back_edges) return nonterminal(rng() % n);
+            return nonterminal(i + 1 + rng() % (n - i - 1));
+        };
+        auto symbol = [&]() {
+            return (chance(rng) < options.terminal_ratio || i + 1 >= n) ? terminal() : reference();
+        };
+
+        int alternatives = 1 + rng() % max(1, options.alternatives);
+        for (int a = 0; a < alternatives; ++a) {
+            string rhs;
+            int length = 1 + rng() % max(1, options.rule_length);
+            for (int s = 0; s < length; ++s) rhs += symbol() + " ";
+            grammar.push_back({nonterminal(i), rhs});
+        }
+        if (chance(rng) < options.epsilon) grammar.push_back({nonterminal(i), "ε"});
+        if (chance(rng) < options.left_recursion) {
+            grammar.push_back({nonterminal(i), nonterminal(i) + " " + symbol()});
+        }
+    }
+    return grammar;
+}
+
+// ---------------------------------------------------------------------------
+// Measurement and checking
+// ---------------------------------------------------------------------------
+
+// nullable flag, FIRST and FOLLOW names per non-terminal
+struct SetsOf {
+    bool nullable;
+    set<string> first, follow;
+    bool operator==(const SetsOf& o) const {
+        return nullable == o.nullable && first == o.first && follow == o.follow;
+    }
+};
+typedef map<string, SetsOf> Result;
+
+struct Measurement {
+    double best_ms = 0;
+    size_t allocations = 0;
+    size_t peak = 0;
+};
+
+template <class F>
+Measurement measure(int runs, F run) {
+    Measurement m;
+    for (int r = 0; r < runs; ++r) {
+        size_t allocations_before = allocation_count.load();
+        size_t live_before = live_bytes.load();
+        peak_bytes.store(live_before);
+
+        auto start = chrono::steady_clock::now();
+        run();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        if (r == 0 || ms < m.best_ms) m.best_ms = ms;
+        if (r == 0) {
+            m.allocations = allocation_count.load() - allocations_before;
+            m.peak = peak_bytes.load() - live_before;
+        }
+    }
+    return m;
+}
+
+Result from_core(const Grammar& g, const vector<char>& nullable, const BitMatrix& first, const BitMatrix& follow) {
+    Result result;
+    for (size_t nt = 0; nt < g.nonterminals.size(); ++nt) {
+        SetsOf& sets = result[g.name(g.nonterminals[nt])];
+        sets.nullable = nullable[nt];
+        bits_for_each(first.row(nt), first.words(), [&](int t) { sets.first.insert(g.name(g.terminals[t])); });
+        bits_for_each(follow.row(nt), follow.words(), [&](int t) { sets.follow.insert(g.name(g.terminals[t])); });
+    }
+    return result;
+}
+
+// Number of non-terminals whose sets differ from the reference
+int count_mismatches(const Result& reference, const Result& result) {
+    int mismatches = 0;
+    for (const auto& entry : reference) {
+        auto it = result.find(entry.first);
+        if (it == result.end() || !(it->second == entry.second)) mismatches++;
+    }
+    return mismatches + max(0, int(result.size()) - int(reference.size()));
+}
+
+// Checks that found a mismatch
+int failed_checks = 0;
+
+void report(const string& name, const Measurement& m, int mismatches) {
+    if (mismatches) failed_checks++;
+    cout << left << setw(30) << name << right
+         << setw(12) << fixed << setprecision(3) << m.best_ms
+         << setw(12) << m.allocations
+         << setw(12) << (m.peak + 1023) / 1024 << "  "
+         << (mismatches == 0 ? string("ok") : "MISMATCH in " + to_string(mismatches) + " sets") << "\n";
+}
+
+void report_tables(const string& name, const Measurement& m, int states, const LRTables* tables) {
+    cout << left << setw(30) << name << right
+         << setw(12) << fixed << setprecision(3) << m.best_ms
+         << setw(12) << m.allocations
+         << setw(12) << (m.peak + 1023) / 1024 << "  " << states << " states";
+    if (tables) {
+        cout << ", " << tables->conflicts.size() << " conflicts, "
+             << (tables->bytes() + 1023) / 1024 << " KiB tables";
+    }
+    cout << "\n";
+}
+
+// ACTION and GOTO entries that differ between two tables over the same
+// automaton; a different size counts as all entries
+size_t table_mismatches(const LRTables& expected, const LRTables& found) {
+    if (expected.action.size() != found.action.size() || expected.go_to.size() != found.go_to.size()) {
+        return max(expected.action.size(), found.action.size()) + max(expected.go_to.size(), found.go_to.size());
+    }
+    size_t mismatches = 0;
+    for (size_t i = 0; i < expected.action.size(); ++i) mismatches += expected.action[i] != found.action[i];
+    for (size_t i = 0; i < expected.go_to.size(); ++i) mismatches += expected.go_to[i] != found.go_to[i];
+    return mismatches;
+}
+
+// Entries where the packed tables disagree with the dense ones. Empty
+// ACTION cells may read back as the row's default reduction; GOTO is only
+// compared where an entry exists.
+size_t packed_mismatches(const LRTables& dense, const PackedLRTables& packed) {
+    size_t mismatches = 0;
+    for (int32_t s = 0; s < dense.states; ++s) {
+        for (int32_t t = 0; t < dense.terminals; ++t) {
+            int32_t expected = dense.action_at(s, t), found = packed.action_at(s, t);
+            if (expected != 0 ? found != expected : found > 0 || found == ~dense.accept_production) mismatches++;
+        }
+        for (int32_t n = 0; n < dense.nonterminals; ++n) {
+            int32_t expected = dense.goto_at(s, n);
+            if (expected >= 0 && packed.goto_at(s, n) != expected) mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+void load(Grammar& g, const GrammarText& text) {
+    for (const auto& production : text) g.add_production(production.first, production.second);
+    g.finalize();
+}
+
+int main(int argc, char** argv) {
+    GeneratorOptions options;
+    int runs = 5;
+    unsigned jobs = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        string value = argv[i + 1];
+        if (flag == "--nonterminals") options.nonterminals = stoi(value);
+        else if (flag == "--terminals") options.terminals = stoi(value);
+        else if (flag == "--alternatives") options.alternatives = stoi(value);
+        else if (flag == "--rule-length") options.rule_length = stoi(value);
+        else if (flag == "--terminal-ratio") options.terminal_ratio = stod(value);
+        else if (flag == "--epsilon") options.epsilon = stod(value);
+        else if (flag == "--left-recursion") options.left_recursion = stod(value);
+        else if (flag == "--back-edges") options.back_edges = stod(value);
+        else if (flag == "--seed") options.seed = stoul(value);
+        else if (flag == "--runs") runs = max(1, stoi(value));
+        else if (flag == "--jobs") jobs = stoul(value);
+        else {
+            cout << "Unknown option: " << flag << "\n";
+            return 1;
+        }
+    }
+
+    GrammarText text = generate_grammar(options);
+    cout << "Grammar: " << options.nonterminals << " non-terminals, " << text.size()
+         << " productions, " << options.terminals << " terminals, seed " << options.seed << "\n\n";
+
+    // Reference result
+    Grammar reference_grammar;
+    load(reference_grammar, text);
+    GrammarAnalysis reference_analysis = analyze(reference_grammar);
+    Result reference = from_core(reference_grammar, reference_analysis.nullable,
+                                 reference_analysis.first, reference_analysis.follow);
+
+    cout << left << setw(30) << "implementation" << right << setw(12) << "best ms"
+         << setw(12) << "allocs" << setw(12) << "peak KiB" << "  check\n";
+
+    {
+        unique_ptr<FirstFollowCalculator> calculator;
+        Measurement m = measure(runs, [&] {
+            calculator.reset(new FirstFollowCalculator());
+            for (const auto& production : text) calculator->add_production(production.first, production.second);
+            calculator->recompute();
+        });
+
+        Result result;
+        for (const auto& entry : reference) {
+            SetsOf& sets = result[entry.first];
+            sets.nullable = calculator->derives_epsilon(entry.first);
+            for (const string& t : calculator->first_set(entry.first)) sets.first.insert(t);
+            for (const string& t : calculator->follow_set(entry.first)) sets.follow.insert(t);
+        }
+        report("first-follow.cpp", m, count_mismatches(reference, result));
+    }
+
+    {
+        Measurement m = measure(runs, [&] {
+            ll::grammar = Grammar();
+            load(ll::grammar, text);
+            ll::computeSets(1);
+        });
+        report("ll.cpp", m, count_mismatches(reference, from_core(ll::grammar, ll::nullable, ll::first, ll::follow)));
+    }
+
+    // ll -j N against the same reference, so it must print exactly what the
+    // sequential path prints; at least two workers, or the parallel solver
+    // falls back to analyze() on a single core
+    unsigned workers = max(2u, jobs ? jobs : thread::hardware_concurrency());
+    {
+        Measurement m = measure(runs, [&] {
+            ll::grammar = Grammar();
+            load(ll::grammar, text);
+            ll::computeSets(workers);
+        });
+        report("ll.cpp -j" + to_string(workers), m,
+               count_mismatches(reference, from_core(ll::grammar, ll::nullable, ll::first, ll::follow)));
+    }
+
+    {
+        Measurement m = measure(runs, [&] {
+            slr::grammar = Grammar();
+            load(slr::grammar, text);
+            slr::computeSets();
+        });
+        report("slr.cpp", m, count_mismatches(reference, from_core(slr::grammar, slr::nullable, slr::first, slr::follow)));
+    }
+
+    {
+        Grammar g;
+        GrammarAnalysis a;
+        Measurement m = measure(runs, [&] {
+            g = Grammar();
+            load(g, text);
+            a = analyze(g);
+        });
+        report("grammar.h analyze", m, count_mismatches(reference, from_core(g, a.nullable, a.first, a.follow)));
+    }
+
+    {
+        ThreadPool pool(workers);
+        Grammar g;
+        GrammarAnalysis a;
+        Measurement m = measure(runs, [&] {
+            g = Grammar();
+            load(g, text);
+            a = analyze_parallel(g, pool);
+        });
+        report("grammar.h analyze_parallel -j" + to_string(pool.size()), m,
+               count_mismatches(reference, from_core(g, a.nullable, a.first, a.follow)));
+    }
+
+    // LR tables: one LR(0) automaton, then SLR(1) and LALR(1) lookaheads on it
+    cout << "\n" << left << setw(30) << "LR tables" << right << setw(12) << "best ms"
+         << setw(12) << "allocs" << setw(12) << "peak KiB" << "  result\n";
+    {
+        LRAutomaton automaton;
+        Measurement m = measure(runs, [&] { automaton = LRAutomaton::build(reference_grammar); });
+        report_tables("LR(0) collection", m, automaton.states(), nullptr);
+
+        LRTables tables;
+        m = measure(runs, [&] { tables = build_slr_tables(automaton, reference_analysis.follow); });
+        report_tables("SLR(1) lookaheads + tables", m, tables.states, &tables);
+
+        m = measure(runs, [&] { tables = build_lalr_tables(automaton, reference_analysis.nullable); });
+        report_tables("LALR(1) lookaheads + tables", m, tables.states, &tables);
+
+        // slr --lalr builds from its own grammar and nullable flags, and has
+        // to end up with the same table
+        slr::lalr = true;
+        m = measure(runs, [&] { slr::buildLRTable(); });
+        report_tables("slr.cpp --lalr", m, slr::parsingTable.states, &slr::parsingTable);
+        size_t lalr_wrong = table_mismatches(tables, slr::parsingTable);
+        if (lalr_wrong) {
+            failed_checks++;
+            cout << "  MISMATCH in " << lalr_wrong << " entries\n";
+        }
+
+        PackedLRTables packed;
+        m = measure(runs, [&] { packed = pack_lr_tables(tables); });
+        report_tables("LALR(1) packed", m, packed.states, nullptr);
+        size_t packed_wrong = packed_mismatches(tables, packed);
+        if (packed_wrong) failed_checks++;
+        cout << "  " << (tables.bytes() + 1023) / 1024 << " KiB dense -> " << (packed.bytes() + 1023) / 1024
+             << " KiB packed (" << setprecision(1) << double(tables.bytes()) / packed.bytes() << "x), "
+             << packed.action.merged_rows() << " distinct ACTION rows, "
+             << packed_wrong << " mismatched entries\n";
+
+        // Random ACTION lookups, the same sequence on both layouts
+        mt19937 rng(options.seed);
+        vector<pair<int32_t, int32_t>> probes(1 << 22);
+        for (auto& probe : probes) probe = {int32_t(rng() % tables.states), int32_t(rng() % tables.terminals)};
+        int64_t dense_sum = 0, packed_sum = 0;
+        Measurement dense_m = measure(runs, [&] {
+            for (const auto& probe : probes) dense_sum += tables.action_at(probe.first, probe.second);
+        });
+        Measurement packed_m = measure(runs, [&] {
+            for (const auto& probe : probes) packed_sum += packed.action_at(probe.first, probe.second);
+        });
+        cout << "  ACTION lookups/sec: dense " << setprecision(0) << probes.size() / dense_m.best_ms * 1000
+             << ", packed " << probes.size() / packed_m.best_ms * 1000
+             << "  (checksums " << dense_sum % 1000 << ", " << packed_sum % 1000 << ")\n";
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    cout << "\nProcess peak RSS: " << usage.ru_maxrss << " KiB\n";
+    if (failed_checks) {
+        cout << failed_checks << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}
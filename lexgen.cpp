@@ -0,0 +1,705 @@
+// Scanner generator for the flex files in this repository.
+//
+// Reads a .l file (definitions, %{ %} code, %option noyywrap, rules with
+// actions, user code), compiles the rules through regex.h, nfa.h and
+// minimize_dfa into one DFA whose accepting states name the first rule
+// that matches, and writes a C++ file with a table-driven yylex(). The
+// scanner follows flex: longest match, earlier rules win ties, yytext and
+// yyleng, ECHO for bytes no rule matches, yywrap() at end of input, and
+// yy_scan_buffer() to scan a caller's buffer in place.
+//
+//   g++ -std=c++17 -O2 -pthread -o lexgen lexgen.cpp
+//   ./lexgen newcode.l -o newcode.yy.cpp && g++ -O2 -pthread -I. -o newcode newcode.yy.cpp
+//
+// --direct writes the DFA as code instead of tables: a label per state and
+// a switch on the next byte, which the compiler turns into jumps with no
+// table loads on the way. --emit-bench writes a program that runs the
+// table-driven or (with --direct) direct-coded matcher over a file without
+// actions, so the two compare on identical rules:
+//
+//   ./lexgen newcode.l --emit-bench -o table.cpp && g++ -O2 -o table table.cpp
+//   ./lexgen newcode.l --emit-bench --direct -o direct.cpp && g++ -O2 -o direct direct.cpp
+//   ./table big.txt 5; ./direct big.txt 5
+//
+// --bench FILE runs the generated tables over FILE (mapped with mmap)
+// without actions and reports MB/s and tokens/s per rule; --jobs N splits
+// FILE into chunks tokenized on N threads, with the same counts. To compare with
+// flex, build both scanners and time them on the same input:
+//
+//   flex -o newcode.flex.cpp newcode.l && g++ -O2 -pthread -I. -o newcode_flex newcode.flex.cpp
+//   time ./newcode < big.txt; time ./newcode_flex < big.txt
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "dfa.h"
+#include "regex.h"
+
+using namespace std;
+
+struct Rule {
+    string pattern;
+    string action;   // "|" for the action of the next rule
+    int line;
+};
+
+struct Spec {
+    string prologue;         // %{ %} blocks and indented lines before the rules
+    string yylex_prologue;   // indented lines and %{ %} before the first rule
+    vector<pair<string, string>> definitions;
+    vector<Rule> rules;
+    string epilogue;         // after the second %%
+    bool yywrap = true;
+};
+
+string trim(const string& s) {
+    size_t first = s.find_first_not_of(" \t\r");
+    if (first == string::npos) return "";
+    return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+}
+
+// Index one past the } that closes the { at start, or npos. Braces in
+// strings, character literals and comments do not count.
+size_t match_brace(const string& text, size_t start) {
+    int depth = 0;
+    for (size_t i = start; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '"' || c == '\'') {
+            for (++i; i < text.size() && text[i] != c; ++i) {
+                if (text[i] == '\\') ++i;
+            }
+        } else if (c == '/' && i + 1 < text.size() && text[i + 1] == '/') {
+            i = text.find('\n', i);
+            if (i == string::npos) return string::npos;
+        } else if (c == '/' && i + 1 < text.size() && text[i + 1] == '*') {
+            i = text.find("*/", i + 2);
+            if (i == string::npos) return string::npos;
+            ++i;
+        } else if (c == '{') {
+            depth++;
+        } else if (c == '}' && --depth == 0) {
+            return i + 1;
+        }
+    }
+    return string::npos;
+}
+
+bool read_spec(const string& path, Spec& spec) {
+    ifstream in(path);
+    if (!in) {
+        cout << "Error: cannot open " << path << "\n";
+        return false;
+    }
+    vector<string> lines;
+    for (string line; getline(in, line);) lines.push_back(line);
+
+    auto error = [&](size_t i, const string& message) {
+        cout << "Error: " << path << ":" << i + 1 << ": " << message << "\n";
+        return false;
+    };
+    // Copies a %{ ... %} block starting at line i into out; i ends on %}
+    auto code_block = [&](size_t& i, string& out) {
+        size_t open = i;
+        for (++i; i < lines.size() && trim(lines[i]) != "%}"; ++i) out += lines[i] + "\n";
+        return i < lines.size() || error(open, "%{ without %}");
+    };
+
+    int section = 0;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const string& line = lines[i];
+        if (section == 2) {
+            spec.epilogue += line + "\n";
+            continue;
+        }
+        if (trim(line) == "%%") {
+            section++;
+            continue;
+        }
+        if (trim(line).empty()) continue;
+        if (line.compare(0, 2, "%{") == 0) {
+            if (!code_block(i, section == 0 ? spec.prologue : spec.yylex_prologue)) return false;
+            continue;
+        }
+
+        if (section == 0) {
+            if (isspace(static_cast<unsigned char>(line[0]))) {
+                spec.prologue += line + "\n";
+            } else if (line.compare(0, 2, "/*") == 0) {
+                size_t open = i;
+                for (; i < lines.size() && lines[i].find("*/") == string::npos; ++i) spec.prologue += lines[i] + "\n";
+                if (i == lines.size()) return error(open, "unterminated comment");
+                spec.prologue += lines[i] + "\n";
+            } else if (line.compare(0, 7, "%option") == 0) {
+                istringstream options(line.substr(7));
+                for (string option; options >> option;) {
+                    if (option == "noyywrap") spec.yywrap = false;
+                    else if (option == "yywrap") spec.yywrap = true;
+                    else cerr << path << ":" << i + 1 << ": ignoring %option " << option << "\n";
+                }
+            } else if (line[0] == '%') {
+                return error(i, "unsupported directive " + line.substr(0, line.find_first_of(" \t")));
+            } else {
+                size_t name_end = line.find_first_of(" \t");
+                if (name_end == string::npos) return error(i, "definition without a pattern");
+                spec.definitions.push_back({line.substr(0, name_end), trim(line.substr(name_end))});
+            }
+            continue;
+        }
+
+        // Rules
+        if (isspace(static_cast<unsigned char>(line[0]))) {
+            if (!spec.rules.empty()) return error(i, "indented line between rules");
+            spec.yylex_prologue += line + "\n";
+            continue;
+        }
+        size_t length = regex_pattern_length(line);
+        Rule rule{line.substr(0, length), trim(line.substr(length)), int(i + 1)};
+        if (!rule.action.empty() && rule.action[0] == '{') {
+            // Braced action, possibly over several lines; the rest of its
+            // last line is dropped
+            size_t open = i;
+            string text = line.substr(line.find('{', length));
+            size_t end;
+            while ((end = match_brace(text, 0)) == string::npos) {
+                if (++i == lines.size()) return error(open, "unterminated action");
+                text += "\n" + lines[i];
+            }
+            rule.action = text.substr(0, end);
+        }
+        spec.rules.push_back(rule);
+    }
+    if (section < 1) return error(lines.size() - 1, "missing %%");
+    if (spec.rules.empty()) return error(lines.size() - 1, "no rules");
+    if (spec.rules.back().action == "|") return error(spec.rules.back().line - 1, "last rule uses |");
+    return true;
+}
+
+// Emits a C array of numbers, 16 to a line
+template <class T>
+void emit_array(ostream& out, const char* type, const char* name, const vector<T>& values) {
+    out << "const " << type << " " << name << "[" << values.size() << "] = {";
+    for (size_t i = 0; i < values.size(); ++i) {
+        out << (i % 16 ? " " : "\n    ") << values[i] << (i + 1 < values.size() ? "," : "");
+    }
+    out << "\n};\n";
+}
+
+// C++ literal for a byte in a case label
+string byte_literal(int b) {
+    if (b == '\'' || b == '\\') return string("'\\") + char(b) + "'";
+    if (isgraph(b) || b == ' ') return string("'") + char(b) + "'";
+    return to_string(b);
+}
+
+// C++ string literal with the same bytes as text
+string string_literal(const string& text) {
+    string literal = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') literal += string("\\") + char(c);
+        else if (isprint(c)) literal += char(c);
+        else literal += "\\" + to_string(c >> 6) + to_string((c >> 3) & 7) + to_string(c & 7);
+    }
+    return literal + "\"";
+}
+
+// Transition tables, and the byte ranges that keep each state on itself
+// with the kernel that skips them; namespace scope
+void emit_tables(ostream& out, const DenseDFA& table) {
+    vector<int> classes(table.classes, table.classes + 256);
+    emit_array(out, "uint16_t", "yy_classes", classes);
+    vector<uint32_t> cells(table.cell_count());
+    for (size_t i = 0; i < cells.size(); ++i) cells[i] = table.cell(i);
+    emit_array(out, table.wide() ? "uint32_t" : "uint16_t", "yy_next", cells);
+    vector<int32_t> rules(table.states);
+    for (int32_t s = 0; s < table.states; ++s) rules[s] = table.token_at(uint32_t(s) * table.class_count);
+    emit_array(out, "short", "yy_rule", rules);
+    out << "const uint32_t yy_class_count = " << table.class_count << ";\n"
+        << "const uint32_t yy_start = " << table.start << ";\n"
+        << "const uint32_t yy_accept_from = " << table.accept_from << ";\n"
+        << "const uint32_t yy_stop_from = " << table.stop_from << ";\n\n";
+
+    vector<int> loop_count(table.states), loop_low(table.states * ByteRanges::max_ranges),
+        loop_high(table.states * ByteRanges::max_ranges);
+    for (int32_t s = 0; s < table.states; ++s) {
+        const ByteRanges& loop = table.loop_at(uint32_t(s) * table.class_count);
+        loop_count[s] = loop.count;
+        for (int i = 0; i < loop.count; ++i) {
+            loop_low[s * ByteRanges::max_ranges + i] = loop.low[i];
+            loop_high[s * ByteRanges::max_ranges + i] = loop.high[i];
+        }
+    }
+    emit_array(out, "unsigned char", "yy_loop_count", loop_count);
+    emit_array(out, "unsigned char", "yy_loop_low", loop_low);
+    emit_array(out, "unsigned char", "yy_loop_high", loop_high);
+    out << R"(// First position in [p, end) whose byte leaves the state at row offset
+// state; the same compares as ByteRanges::skip in dfa.h
+const unsigned char* yy_skip(const unsigned char* p, const unsigned char* end, uint32_t state) {
+    int count = yy_loop_count[state / yy_class_count];
+    const unsigned char* low = yy_loop_low + state / yy_class_count * 4;
+    const unsigned char* high = yy_loop_high + state / yy_class_count * 4;
+#if defined(__AVX2__)
+    __m256i low32[4], width32[4];
+    for (int i = 0; i < count; ++i) {
+        low32[i] = _mm256_set1_epi8(char(low[i]));
+        width32[i] = _mm256_set1_epi8(char(high[i] - low[i]));
+    }
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i in = _mm256_setzero_si256();
+        for (int i = 0; i < count; ++i) {
+            __m256i over = _mm256_subs_epu8(_mm256_sub_epi8(x, low32[i]), width32[i]);
+            in = _mm256_or_si256(in, _mm256_cmpeq_epi8(over, _mm256_setzero_si256()));
+        }
+        uint32_t outside = ~uint32_t(_mm256_movemask_epi8(in));
+        if (outside) return p + __builtin_ctz(outside);
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i low16[4], width16[4];
+    for (int i = 0; i < count; ++i) {
+        low16[i] = _mm_set1_epi8(char(low[i]));
+        width16[i] = _mm_set1_epi8(char(high[i] - low[i]));
+    }
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i in = _mm_setzero_si128();
+        for (int i = 0; i < count; ++i) {
+            __m128i over = _mm_subs_epu8(_mm_sub_epi8(x, low16[i]), width16[i]);
+            in = _mm_or_si128(in, _mm_cmpeq_epi8(over, _mm_setzero_si128()));
+        }
+        uint32_t outside = ~uint32_t(_mm_movemask_epi8(in)) & 0xffff;
+        if (outside) return p + __builtin_ctz(outside);
+    }
+#endif
+    for (; p != end; ++p) {
+        bool in = false;
+        for (int i = 0; i < count; ++i) in |= uint8_t(*p - low[i]) <= uint8_t(high[i] - low[i]);
+        if (!in) break;
+    }
+    return p;
+}
+
+)";
+}
+
+// Longest match at yy_pos in yy_buffer, leaving the rule in yy_act (-1
+// if none) and the end of the match in last. out_of_input is a condition
+// tested when q reaches yy_end; it may read more input and be false.
+// Stops at the dead state or at a state nothing longer can match from.
+void emit_table_match(ostream& out, const string& out_of_input) {
+    out << R"(        uint32_t state = yy_start, accepted = 0;
+        size_t q = yy_pos, last = yy_pos;
+        for (;;) {
+            if ()" << out_of_input << R"() break;
+            uint32_t from = state;
+            state = yy_next[state + yy_classes[static_cast<unsigned char>(yy_buffer[q++])]];
+            if (state == 0) break;
+            if (state == from && yy_loop_count[state / yy_class_count]) {
+                const unsigned char* base = reinterpret_cast<const unsigned char*>(yy_buffer);
+                q = yy_skip(base + q, base + yy_end, state) - base;
+            }
+            if (state >= yy_accept_from) {
+                accepted = state;
+                last = q;
+                if (state >= yy_stop_from) break;
+            }
+        }
+        int yy_act = accepted ? yy_rule[accepted / yy_class_count] : -1;
+)";
+}
+
+// The same match with the DFA as code: a label per state, entered with
+// the bytes up to q consumed, and a switch on the next byte that jumps to
+// the target. Each switch defaults to its most common target. As in the
+// table walk, an accepting start state counts only when a jump comes back
+// to it, so a nullable rule never makes an empty match.
+void emit_direct_match(ostream& out, const DenseDFA& table, const string& out_of_input) {
+    int32_t n = table.states;
+    auto target = [&](int32_t s, int b) {
+        return int32_t(table.cell(size_t(s) * table.class_count + table.classes[b]) / table.class_count);
+    };
+    // Labels that some jump uses; the start is entered by falling through
+    vector<char> used(n, 0);
+    for (int32_t s = 1; s < n; ++s) {
+        for (int b = 0; b < 256; ++b) used[target(s, b)] = 1;
+    }
+    vector<int32_t> order{int32_t(table.start / table.class_count)};
+    for (int32_t s = 1; s < n; ++s) {
+        if (s != order[0]) order.push_back(s);
+    }
+
+    out << "        int yy_act = -1;\n        size_t q = yy_pos, last = yy_pos;\n";
+    for (int32_t s : order) {
+        uint32_t offset = uint32_t(s) * table.class_count;
+        bool accepting = offset >= table.accept_from;
+        bool entry = s == order[0] && accepting;   // fall through past the accept
+        if (entry && used[s]) out << "        goto yy_entry;\n";
+        if (used[s]) out << "    yy_state_" << s << ":\n";
+        if (accepting && (used[s] || !entry)) {
+            out << "        yy_act = " << table.token_at(offset) << ";\n        last = q;\n";
+        }
+        if (entry && used[s]) out << "    yy_entry:\n";
+        if (offset >= table.stop_from) {
+            out << "        goto yy_matched;\n";
+            continue;
+        }
+        out << "        if (" << out_of_input << ") goto yy_matched;\n"
+            << "        switch (static_cast<unsigned char>(yy_buffer[q++])) {\n";
+        map<int32_t, vector<int>> bytes_to;
+        for (int b = 0; b < 256; ++b) bytes_to[target(s, b)].push_back(b);
+        int32_t common = bytes_to.begin()->first;
+        for (const auto& entry : bytes_to) {
+            if (entry.second.size() > bytes_to.at(common).size()) common = entry.first;
+        }
+        auto jump = [&](int32_t t) { return t ? "goto yy_state_" + to_string(t) : string("goto yy_matched"); };
+        for (const auto& entry : bytes_to) {
+            if (entry.first == common) continue;
+            for (size_t i = 0; i < entry.second.size(); ++i) {
+                out << (i % 8 ? " " : i ? "\n        " : "        ") << "case " << byte_literal(entry.second[i]) << ":";
+            }
+            out << "\n            " << jump(entry.first) << ";\n";
+        }
+        out << "        default:\n            " << jump(common) << ";\n        }\n";
+    }
+    out << "    yy_matched:\n";
+}
+
+void emit_scanner(ostream& out, const string& source, const Spec& spec, const DenseDFA& table, bool direct) {
+    out << "// Generated by lexgen from " << source << "; do not edit.\n"
+        << "// " << spec.rules.size() << " rules, " << table.states << " states, ";
+    if (direct) out << "direct-coded.\n\n";
+    else out << table.class_count << " byte classes, " << (table.wide() ? 32 : 16) << "-bit cells.\n\n";
+    out << spec.prologue << "\n";
+    out << "#include <cerrno>\n#include <cstdint>\n#include <cstdio>\n#include <cstdlib>\n#include <cstring>\n"
+        << "#include <unistd.h>\n";
+    if (!direct) out << "#if defined(__AVX2__) || defined(__SSE2__)\n#include <immintrin.h>\n#endif\n";
+    out << "\nFILE* yyin = nullptr;\nFILE* yyout = nullptr;\nchar* yytext = nullptr;\nint yyleng = 0;\n";
+    if (spec.yywrap) out << "int yywrap();\n";
+    out << "\n#define ECHO fwrite(yytext, 1, yyleng, yyout)\n#define yyterminate() return 0\n\n";
+
+    out << "namespace {\n\n";
+    if (!direct) emit_tables(out, table);
+
+    // Input buffer
+    out << R"(// Unread input is [yy_pos, yy_end); the byte after yytext is replaced by
+// a NUL while an action runs and restored before the next match
+char* yy_buffer = nullptr;
+size_t yy_capacity = 0;
+size_t yy_pos = 0;
+size_t yy_end = 0;
+size_t yy_hold_at = SIZE_MAX;
+char yy_hold = 0;
+bool yy_eof = false;
+
+// Reads more input after moving the unread bytes to the front; false at
+// end of input
+bool yy_fill() {
+    if (yy_eof) return false;
+    if (yy_capacity == 0 && yy_buffer) {
+        // The caller's buffer from yy_scan_buffer is used up; read yyin
+        // into a buffer of our own
+        yy_buffer = nullptr;
+        yy_pos = yy_end = 0;
+    }
+    if (yy_pos > 0) {
+        memmove(yy_buffer, yy_buffer + yy_pos, yy_end - yy_pos);
+        yy_end -= yy_pos;
+        yy_pos = 0;
+    }
+    if (yy_end + 1 >= yy_capacity) {
+        yy_capacity = yy_capacity ? yy_capacity * 2 : 1 << 16;
+        yy_buffer = static_cast<char*>(realloc(yy_buffer, yy_capacity));
+        if (!yy_buffer) {
+            fputs("lexgen scanner: out of memory\n", stderr);
+            exit(2);
+        }
+    }
+    ssize_t n;
+    do {
+        n = read(fileno(yyin), yy_buffer + yy_end, yy_capacity - yy_end - 1);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        yy_eof = true;
+        return false;
+    }
+    yy_end += n;
+    return true;
+}
+
+// yy_fill() in the middle of a match at q, after accepting up to last.
+// Filling moves the token to the front, even at end of input.
+bool yy_refill(size_t& q, size_t& last) {
+    size_t moved = yy_pos;
+    bool more = yy_fill();
+    q -= moved - yy_pos;
+    last -= moved - yy_pos;
+    return more;
+}
+
+}  // namespace
+
+// Scans base[0, size - 2) in place instead of reading yyin, as flex does;
+// the last two bytes must be NUL. Tokens point into base, which must stay
+// writable and alive until yylex() returns 0.
+struct yy_buffer_state {
+    char* base;
+    size_t size;
+};
+typedef yy_buffer_state* YY_BUFFER_STATE;
+
+YY_BUFFER_STATE yy_scan_buffer(char* base, size_t size) {
+    static yy_buffer_state state;
+    if (size < 2 || base[size - 2] || base[size - 1]) return nullptr;
+    if (yy_hold_at != SIZE_MAX) yy_buffer[yy_hold_at] = yy_hold;
+    if (yy_capacity) free(yy_buffer);
+    yy_buffer = base;
+    yy_capacity = 0;
+    yy_pos = 0;
+    yy_end = size - 2;
+    yy_hold_at = SIZE_MAX;
+    yy_eof = true;
+    state = {base, size};
+    return &state;
+}
+
+int yylex() {
+    if (!yyin) yyin = stdin;
+    if (!yyout) yyout = stdout;
+)";
+    out << spec.yylex_prologue;
+    out << R"(
+    for (;;) {
+        if (yy_hold_at != SIZE_MAX) {
+            yy_buffer[yy_hold_at] = yy_hold;
+            yy_hold_at = SIZE_MAX;
+        }
+        if (yy_pos == yy_end && !yy_fill()) {
+)" << (spec.yywrap ? "            if (yywrap()) return 0;\n            yy_eof = false;\n            continue;\n"
+                   : "            return 0;\n")
+        << "        }\n\n";
+    if (direct) emit_direct_match(out, table, "q == yy_end && !yy_refill(q, last)");
+    else emit_table_match(out, "q == yy_end && !yy_refill(q, last)");
+    out << R"(
+        if (yy_act < 0) last = yy_pos + 1;
+        yytext = yy_buffer + yy_pos;
+        yyleng = int(last - yy_pos);
+        yy_hold = yy_buffer[last];
+        yy_hold_at = last;
+        yy_buffer[last] = '\0';
+        yy_pos = last;
+
+        switch (yy_act) {
+)";
+    for (size_t r = 0; r < spec.rules.size(); ++r) {
+        // The line number also keeps a trailing backslash from splicing lines
+        out << "        case " << r << ":  // " << spec.rules[r].pattern << ", line " << spec.rules[r].line << "\n";
+        if (spec.rules[r].action == "|") continue;
+        if (!spec.rules[r].action.empty()) out << "            " << spec.rules[r].action << "\n";
+        out << "            break;\n";
+    }
+    out << "        default:\n            ECHO;\n            break;\n        }\n    }\n}\n\n";
+    out << spec.epilogue;
+}
+
+// A program that runs the matcher of emit_scanner over a mapped file
+// without actions, reporting as bench() does; built from the same tables
+// or code, so table-driven and direct-coded matching compare directly
+void emit_bench(ostream& out, const string& source, const Spec& spec, const DenseDFA& table, bool direct) {
+    out << "// Generated by lexgen from " << source << "; do not edit.\n"
+        << "// Benchmark of the " << (direct ? "direct-coded" : "table-driven")
+        << " matcher: ./bench FILE [PASSES]\n\n"
+        << "#include <chrono>\n#include <cstdint>\n#include <cstdio>\n#include <cstdlib>\n"
+        << "#include <fcntl.h>\n#include <sys/mman.h>\n#include <sys/stat.h>\n#include <unistd.h>\n";
+    if (!direct) out << "#if defined(__AVX2__) || defined(__SSE2__)\n#include <immintrin.h>\n#endif\n";
+    out << "\nnamespace {\n\n";
+    if (!direct) emit_tables(out, table);
+    out << "const char* yy_patterns[" << spec.rules.size() + 1 << "] = {\n";
+    for (const Rule& rule : spec.rules) out << "    " << string_literal(rule.pattern) << ",\n";
+    out << "    \"(echoed)\",\n};\n\n}  // namespace\n\n";
+
+    out << R"(int main(int argc, char** argv) {
+    int fd = argc > 1 ? open(argv[1], O_RDONLY) : -1;
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "usage: %s FILE [PASSES]\n", argv[0]);
+        return 1;
+    }
+    int passes = argc > 2 ? atoi(argv[2]) : 1;
+    if (passes < 1) passes = 1;
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "mmap failed for %s\n", argv[1]);
+        return 1;
+    }
+    const char* yy_buffer = static_cast<const char*>(map);
+    size_t yy_end = st.st_size;
+
+    const int rules = )" << spec.rules.size() << R"(;
+    size_t counts[rules + 1] = {};   // last: bytes echoed
+    size_t tokens = 0;
+    auto started = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        size_t yy_pos = 0;
+        while (yy_pos < yy_end) {
+)";
+    // The matcher is indented for the scanner loop; the extra level here
+    // does not matter in generated code
+    if (direct) emit_direct_match(out, table, "q == yy_end");
+    else emit_table_match(out, "q == yy_end");
+    out << R"(
+        if (yy_act < 0) last = yy_pos + 1;
+        counts[yy_act < 0 ? rules : yy_act]++;
+        tokens++;
+        yy_pos = last;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double mb = double(yy_end) * passes / (1 << 20);
+    printf("%s: %.1f MB in %.2f s, %.1f MB/s, %.1fM tokens/s ()" << (direct ? "direct-coded" : "table-driven")
+        << R"()\n", argv[1], mb, seconds, mb / seconds,
+           tokens / seconds / 1e6);
+    for (int r = 0; r <= rules; ++r) printf("  %12zu  %s\n", counts[r] / passes, yy_patterns[r]);
+    munmap(map, st.st_size);
+    return 0;
+}
+)";
+}
+
+// Tokens per rule over a mapped file, without running actions; on more
+// than one job the file is tokenized in chunks in parallel
+int bench(const string& path, const Spec& spec, const DenseDFA& table, int passes, unsigned jobs) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        cout << "Error: cannot read " << path << "\n";
+        return 1;
+    }
+    size_t size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        cout << "Error: mmap failed for " << path << "\n";
+        return 1;
+    }
+
+    vector<size_t> counts(spec.rules.size() + 1, 0);   // last: bytes echoed
+    const char* data = static_cast<const char*>(map);
+    size_t tokens = 0;
+    double seconds;
+    if (jobs > 1) {
+        ThreadPool pool(jobs);
+        const size_t chunk_bytes = 1 << 20;
+        vector<vector<size_t>> chunk_counts((size + chunk_bytes - 1) / chunk_bytes, vector<size_t>(counts.size(), 0));
+        auto start = chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; ++pass) {
+            tokens += table.tokenize_parallel(data, size, pool, [&](size_t chunk, int32_t rule, size_t, size_t) {
+                chunk_counts[chunk][rule < 0 ? spec.rules.size() : rule]++;
+            }, chunk_bytes);
+        }
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        for (const auto& part : chunk_counts) {
+            for (size_t r = 0; r < counts.size(); ++r) counts[r] += part[r];
+        }
+    } else {
+        auto start = chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; ++pass) {
+            tokens += table.tokenize(data, size, [&](int32_t rule, size_t, size_t) {
+                counts[rule < 0 ? spec.rules.size() : rule]++;
+            });
+        }
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    munmap(map, size);
+
+    double mb = double(size) * passes / (1 << 20);
+    cout << fixed << setprecision(1) << path << ": " << mb << " MB in " << seconds << " s, " << mb / seconds
+         << " MB/s, " << tokens / seconds / 1e6 << "M tokens/s\n";
+    for (size_t r = 0; r <= spec.rules.size(); ++r) {
+        cout << "  " << setw(12) << counts[r] / passes << "  "
+             << (r < spec.rules.size() ? spec.rules[r].pattern : "(echoed)") << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    string source, output = "lex.yy.cpp", bench_input;
+    int passes = 1;
+    unsigned jobs = 1;
+    bool direct = false, emit_benchmark = false;
+    const string usage = " FILE.l [-o OUTPUT] [--direct] [--emit-bench] [--bench INPUT [--passes N] [--jobs N]]\n";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if ((arg == "-o" || arg == "--bench" || arg == "--passes" || arg == "--jobs") && i + 1 < argc) {
+            string value = argv[++i];
+            if (arg == "-o") output = value;
+            else if (arg == "--bench") bench_input = value;
+            else if (arg == "--jobs") jobs = max(1, stoi(value));
+            else passes = max(1, stoi(value));
+        } else if (arg == "--direct") {
+            direct = true;
+        } else if (arg == "--emit-bench") {
+            emit_benchmark = true;
+        } else if (source.empty() && arg[0] != '-') {
+            source = arg;
+        } else {
+            cout << "Usage: " << argv[0] << usage;
+            return 1;
+        }
+    }
+    if (source.empty()) {
+        cout << "Usage: " << argv[0] << usage;
+        return 1;
+    }
+
+    Spec spec;
+    if (!read_spec(source, spec)) return 1;
+
+    // Rule r accepts token r, so the first of several matching rules wins
+    NFAToDFAConverter nfa;
+    RegexCompiler regex(nfa);
+    for (const auto& definition : spec.definitions) regex.define(definition.first, definition.second);
+    for (size_t r = 0; r < spec.rules.size(); ++r) {
+        if (!regex.add_rule(spec.rules[r].pattern, r)) {
+            cout << "Error: " << source << ":" << spec.rules[r].line << ": " << regex.error() << " in "
+                 << spec.rules[r].pattern << "\n";
+            return 1;
+        }
+    }
+    DFA dfa = nfa.determinize();
+    DFA minimal = minimize_dfa(dfa);
+    DenseDFA table(minimal);
+
+    vector<char> reachable(spec.rules.size(), 0);
+    for (int32_t token : minimal.accepting) {
+        if (token >= 0) reachable[token] = 1;
+    }
+    for (size_t r = 0; r < spec.rules.size(); ++r) {
+        if (!reachable[r]) cerr << source << ":" << spec.rules[r].line << ": warning, rule cannot be matched\n";
+    }
+
+    cout << source << ": " << spec.rules.size() << " rules, " << nfa.state_count() << " NFA states, " << dfa.states
+         << " DFA states, " << minimal.states << " minimized, " << table.class_count << " byte classes, "
+         << table.bytes() << " table bytes\n";
+
+    if (!bench_input.empty()) return bench(bench_input, spec, table, passes, jobs);
+
+    ofstream out(output);
+    if (emit_benchmark) emit_bench(out, source, spec, table, direct);
+    else emit_scanner(out, source, spec, table, direct);
+    if (!out) {
+        cout << "Error: cannot write " << output << "\n";
+        return 1;
+    }
+    cout << "Wrote " << output << "\n";
+    return 0;
+}
@@ -1,174 +1,234 @@
 #include <iostream>
-#include <map>
-#include <set>
 #include <vector>
 #include <string>
+#include <cstdio>
+#include <chrono>
+#include "grammar.h"
+#include "ll1.h"
+#include "table_file.h"
+#include "table_pack.h"
 
 using namespace std;
 
-map<char, set<char>> first, follow;
-map<char, vector<string>> productions;
-map<pair<char, char>, string> parsingTable;
-set<char> terminals, nonTerminals;
-
-void computeFirst(char symbol);
-void computeFollow(char symbol);
+// Grammar with interned symbols; sets are bit rows over terminal indexes
+Grammar grammar;
+vector<char> nullable;
+BitMatrix first, follow;
+// Predict set of every production: FIRST(rhs), plus FOLLOW(lhs) if rhs is nullable
+BitMatrix predict;
+// Dense parsing table: cells[nt * terminals + t] = production index or -1,
+// with every right-hand side stored as an integer symbol array (see ll1.h)
+LL1Table parsingTable;
+
+void computeSets(unsigned workers);
 void constructLL1Table();
 void displayParsingTable();
+int saveTables(const char* path);
+int loadTables(const char* path, const char* inputPath);
+int parseFile(const char* path, const LL1TableView& table,
+              const NameTableView& terminals, const NameTableView& nonTerminals);
+
+#ifndef GRAMMAR_BENCH
+int main(int argc, char** argv) {
+    // -j N: solve FIRST/FOLLOW with the parallel component solver on N workers
+    // --parse FILE: parse FILE (whitespace separated terminals) with the table
+    // --save FILE: write the computed tables to a binary table file
+    // --tables FILE: map a saved table file instead of reading a grammar
+    unsigned workers = 1;
+    const char* inputPath = nullptr;
+    const char* savePath = nullptr;
+    const char* tablesPath = nullptr;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "-j") workers = stoi(argv[i + 1]);
+        if (string(argv[i]) == "--parse") inputPath = argv[i + 1];
+        if (string(argv[i]) == "--save") savePath = argv[i + 1];
+        if (string(argv[i]) == "--tables") tablesPath = argv[i + 1];
+    }
+
+    if (tablesPath) return loadTables(tablesPath, inputPath);
 
-int main() {
     int n;
     cout << "Enter number of productions: ";
     cin >> n;
 
-    cout << "Enter productions (e.g., E->TX, X->+TX|ε):\n";
-    for (int i = 0; i < n; i++) {
-        string prod;
-        cin >> prod;
-        char nonTerm = prod[0];
-        nonTerminals.insert(nonTerm);
-        string rhs = prod.substr(3);
-        size_t pos = 0;
-        while ((pos = rhs.find('|')) != string::npos) {
-            productions[nonTerm].push_back(rhs.substr(0, pos));
-            rhs.erase(0, pos + 1);
+    cout << "Enter productions (e.g., E -> T X, X -> + T X | ε):\n";
+    string prod;
+    getline(cin, prod);
+    for (int i = 0; i < n && getline(cin, prod); ) {
+        if (prod.find_first_not_of(" \t\r") == string::npos) continue;
+        if (!grammar.add_rule(prod)) {
+            cout << "Error: expected '->' in production: " << prod << "\n";
+            return 1;
         }
-        productions[nonTerm].push_back(rhs);
-    }
-
-    for (map<char, vector<string>>::iterator it = productions.begin(); it != productions.end(); ++it) {
-        computeFirst(it->first);
-    }
-
-    for (map<char, vector<string>>::iterator it = productions.begin(); it != productions.end(); ++it) {
-        computeFollow(it->first);
+        i++;
     }
+    grammar.finalize();
 
+    computeSets(workers);
     constructLL1Table();
     displayParsingTable();
-    
-    return 0;
-}
 
-// Compute FIRST set for a given non-terminal
-void computeFirst(char symbol) {
-    if (!first[symbol].empty()) return;  // Already computed
-
-    for (vector<string>::iterator it = productions[symbol].begin(); it != productions[symbol].end(); ++it) {
-        string prod = *it;
-        for (size_t i = 0; i < prod.size(); i++) {
-            char ch = prod[i];
-
-            if (!isupper(ch)) {  // Terminal
-                first[symbol].insert(ch);
-                terminals.insert(ch);
-                break;
-            } else {  // Non-terminal
-                computeFirst(ch);
-                first[symbol].insert(first[ch].begin(), first[ch].end());
-                if (first[ch].find('ε') == first[ch].end()) break;  // Stop if ε is not in FIRST(ch)
-            }
-        }
+    if (savePath && saveTables(savePath) != 0) return 1;
+    if (inputPath) {
+        NameTable terminals = terminal_names(grammar);
+        NameTable nonTerminals = nonterminal_names(grammar);
+        return parseFile(inputPath, parsingTable.view(), terminals.view(), nonTerminals.view());
     }
+    return 0;
 }
-
-// Compute FOLLOW set for a given non-terminal
-void computeFollow(char symbol) {
-    if (!follow[symbol].empty()) return;  // Already computed
-
-    if (symbol == *nonTerminals.begin()) follow[symbol].insert('$'); // Start symbol
-
-    for (map<char, vector<string>>::iterator it = productions.begin(); it != productions.end(); ++it) {
-        char nt = it->first;
-        vector<string> prods = it->second;
-
-        for (vector<string>::iterator pIt = prods.begin(); pIt != prods.end(); ++pIt) {
-            string prod = *pIt;
-            size_t pos = prod.find(symbol);
-            while (pos != string::npos) {
-                if (pos + 1 < prod.length()) {  // Symbol is not at the end
-                    char next = prod[pos + 1];
-                    if (!isupper(next)) follow[symbol].insert(next);
-                    else {
-                        follow[symbol].insert(first[next].begin(), first[next].end());
-                        follow[symbol].erase('ε');  // Remove ε if present
-                        if (first[next].find('ε') != first[next].end()) computeFollow(nt);
-                    }
-                } else {  // Symbol at end, inherit FOLLOW of nt
-                    computeFollow(nt);
-                    follow[symbol].insert(follow[nt].begin(), follow[nt].end());
-                }
-                pos = prod.find(symbol, pos + 1);
-            }
-        }
+#endif
+
+// Compute nullable, FIRST and FOLLOW for the finalized grammar with the
+// shared solver; more than one worker solves it on a thread pool, with the
+// same result
+void computeSets(unsigned workers) {
+    GrammarAnalysis analysis;
+    if (workers != 1) {
+        ThreadPool pool(workers);
+        analysis = analyze_parallel(grammar, pool);
+    } else {
+        analysis = analyze(grammar);
     }
+    nullable = move(analysis.nullable);
+    first = move(analysis.first);
+    follow = move(analysis.follow);
 }
 
 // Construct the LL(1) Parsing Table
 void constructLL1Table() {
-    for (map<char, vector<string>>::iterator it = productions.begin(); it != productions.end(); ++it) {
-        char nt = it->first;
-        vector<string> prods = it->second;
-
-        for (vector<string>::iterator pIt = prods.begin(); pIt != prods.end(); ++pIt) {
-            string prod = *pIt;
-            set<char> firstSet;
-            
-            for (size_t i = 0; i < prod.size(); i++) {
-                char ch = prod[i];
-
-                if (!isupper(ch)) {
-                    firstSet.insert(ch);
-                    break;
-                } else {
-                    firstSet.insert(first[ch].begin(), first[ch].end());
-                    if (first[ch].find('ε') == first[ch].end()) break;
-                }
+    size_t terms = grammar.terminals.size();
+    predict = BitMatrix(grammar.productions.size(), terms);
+    parsingTable = LL1Table::layout(grammar);
+
+    for (size_t p = 0; p < grammar.productions.size(); ++p) {
+        const Production& production = grammar.productions[p];
+        int nt = grammar.nt_of[production.lhs];
+        uint64_t* row = predict.row(p);
+
+        bool derivesEpsilon = true;
+        for (int symbol : production.rhs) {
+            int next = grammar.nt_of[symbol];
+            if (next < 0) {
+                bits_set(row, grammar.term_of[symbol]);
+                derivesEpsilon = false;
+                break;
             }
-
-            for (set<char>::iterator fIt = firstSet.begin(); fIt != firstSet.end(); ++fIt) {
-                if (*fIt != 'ε') parsingTable[{nt, *fIt}] = prod;
+            bits_union(row, first.row(next), predict.words());
+            if (!nullable[next]) {
+                derivesEpsilon = false;
+                break;
             }
+        }
+        if (derivesEpsilon) bits_union(row, follow.row(nt), predict.words());
 
-            if (firstSet.find('ε') != firstSet.end()) {
-                for (set<char>::iterator fIt = follow[nt].begin(); fIt != follow[nt].end(); ++fIt) {
-                    parsingTable[{nt, *fIt}] = "ε";
-                }
+        bits_for_each(row, predict.words(), [&](int t) {
+            int& cell = parsingTable.cells[nt * terms + t];
+            if (cell >= 0 && cell != int(p)) {
+                cout << "LL(1) conflict at M[" << grammar.name(production.lhs) << ", "
+                     << grammar.name(grammar.terminals[t]) << "]\n";
             }
-        }
+            cell = p;
+        });
     }
 }
 
 // Display the LL(1) Parsing Table
 void displayParsingTable() {
+    size_t terms = grammar.terminals.size();
+
     cout << "\nLL(1) Parsing Table:\n";
     cout << "------------------------------------\n";
     cout << "   | ";
-    
-    for (set<char>::iterator it = terminals.begin(); it != terminals.end(); ++it) {
-        cout << *it << "  | ";
+
+    // $ is terminal 0 but is shown in the last column
+    for (size_t t = 1; t < terms; ++t) {
+        cout << grammar.name(grammar.terminals[t]) << "  | ";
     }
-    
+
     cout << "$  |\n";
     cout << "------------------------------------\n";
 
-    for (set<char>::iterator it = nonTerminals.begin(); it != nonTerminals.end(); ++it) {
-        char nt = *it;
-        cout << nt << "  | ";
-
-        for (set<char>::iterator termIt = terminals.begin(); termIt != terminals.end(); ++termIt) {
-            char terminal = *termIt;
-            if (parsingTable.find({nt, terminal}) != parsingTable.end())
-                cout << nt << "->" << parsingTable[{nt, terminal}] << " | ";
-            else 
-                cout << "  -  | ";
+    for (size_t nt = 0; nt < grammar.nonterminals.size(); ++nt) {
+        const string& name = grammar.name(grammar.nonterminals[nt]);
+        cout << name << "  | ";
+
+        for (size_t i = 1; i <= terms; ++i) {
+            size_t t = i % terms;
+            int p = parsingTable.cells[nt * terms + t];
+            if (p >= 0)
+                cout << name << "->" << grammar.rhs_text(p) << (t ? " | " : " |\n");
+            else
+                cout << (t ? "  -  | " : "  -  |\n");
         }
-
-        if (parsingTable.find({nt, '$'}) != parsingTable.end())
-            cout << nt << "->" << parsingTable[{nt, '$'}] << " |\n";
-        else 
-            cout << "  -  |\n";
     }
-    
+
     cout << "------------------------------------\n";
+
+    PackedTable packed = pack_ll1_table(parsingTable.view());
+    size_t dense = parsingTable.cells.size() * sizeof(int32_t);
+    cout << "Table: " << dense << " bytes dense, " << packed.bytes() << " bytes packed ("
+         << packed.merged_rows() << " distinct rows)\n";
+}
+
+// Write the symbols, sets and parse table for later runs with --tables
+int saveTables(const char* path) {
+    TableWriter writer;
+    add_ll1_tables(writer, grammar, nullable, first, follow, parsingTable);
+    if (!writer.write(path)) {
+        cout << "Error: cannot write " << path << "\n";
+        return 1;
+    }
+    cout << "\nTables written to " << path << "\n";
+    return 0;
+}
+
+// Map a saved table file and parse with it directly
+int loadTables(const char* path, const char* inputPath) {
+    auto start = chrono::steady_clock::now();
+    MappedTables tables;
+    if (!tables.open(path)) {
+        cout << "Error: " << path << ": " << tables.error() << "\n";
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    const tablefile::Meta& meta = tables.meta();
+    cout << "Loaded " << path << " in " << seconds * 1e6 << " us: " << meta.nonterminals
+         << " non-terminals, " << meta.terminals << " terminals, " << meta.productions << " productions\n";
+
+    if (!inputPath) return 0;
+    return parseFile(inputPath, tables.ll1(), tables.terminals(), tables.nonterminals());
+}
+
+// Parse a token file with the table and report throughput
+int parseFile(const char* path, const LL1TableView& table,
+              const NameTableView& terminals, const NameTableView& nonTerminals) {
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+        cout << "Error: cannot open " << path << "\n";
+        return 1;
+    }
+
+    TokenReader tokens(in, terminals);
+    LL1Parser parser(table);
+    size_t expansions = 0;
+
+    auto start = chrono::steady_clock::now();
+    LL1ParseResult result = parser.parse(tokens, [&](int32_t) { expansions++; });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fclose(in);
+
+    cout << "\nParsed " << result.tokens << " tokens, " << expansions << " expansions in "
+         << seconds * 1000 << " ms (" << (seconds > 0 ? result.tokens / seconds : 0) << " tokens/sec)\n";
+    if (result.accepted) {
+        cout << "Input accepted.\n";
+        return 0;
+    }
+
+    int expected = result.expected;
+    string found = result.found == 0 ? string("end of input") : "'" + string(tokens.last) + "'";
+    if (result.found < 0) found = "unknown token " + found;
+    cout << "Syntax error at token " << result.tokens + 1 << " (" << found << "): expected "
+         << (expected >= 0 ? terminals.name(expected) : nonTerminals.name(~expected)) << "\n";
+    return 1;
 }
@@ -0,0 +1,292 @@
+#ifndef LL1_H
+#define LL1_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <string_view>
+#include "grammar.h"
+
+// Table-driven LL(1) parsing over dense integer tables.
+//
+// Terminals and non-terminals are the dense indexes of grammar.h. In
+// right-hand sides a terminal t is stored as t and a non-terminal n as ~n,
+// so the sign tells them apart without another lookup.
+
+// Read-only view of an LL(1) table: all the parser needs, as flat arrays.
+// The arrays may live in an LL1Table or anywhere else (e.g. a mapped file).
+struct LL1TableView {
+    int32_t nonterminals = 0;
+    int32_t terminals = 0;        // including "$" at index 0
+    int32_t productions = 0;
+    int32_t start = 0;            // start non-terminal
+    const int32_t* cells = nullptr;        // [nt * terminals + t] -> production or -1
+    const int32_t* lhs = nullptr;          // production -> non-terminal
+    const int32_t* rhs_offsets = nullptr;  // production -> first symbol, size productions + 1
+    const int32_t* rhs_symbols = nullptr;  // encoded symbols
+
+    int32_t cell(int nt, int t) const { return cells[size_t(nt) * terminals + t]; }
+};
+
+// Owning LL(1) table
+struct LL1Table {
+    int32_t nonterminals = 0;
+    int32_t terminals = 0;
+    int32_t start = 0;
+    std::vector<int32_t> cells;
+    std::vector<int32_t> lhs;
+    std::vector<int32_t> rhs_offsets;
+    std::vector<int32_t> rhs_symbols;
+
+    // Lays out the productions of a finalized grammar with an empty table
+    static LL1Table layout(const Grammar& g) {
+        LL1Table table;
+        table.nonterminals = g.nonterminals.size();
+        table.terminals = g.terminals.size();
+        table.start = g.start;
+        table.cells.assign(size_t(table.nonterminals) * table.terminals, -1);
+        table.rhs_offsets.push_back(0);
+        for (const Production& production : g.productions) {
+            table.lhs.push_back(g.nt_of[production.lhs]);
+            for (int symbol : production.rhs) {
+                int nt = g.nt_of[symbol];
+                table.rhs_symbols.push_back(nt >= 0 ? ~nt : g.term_of[symbol]);
+            }
+            table.rhs_offsets.push_back(table.rhs_symbols.size());
+        }
+        return table;
+    }
+
+    LL1TableView view() const {
+        LL1TableView v;
+        v.nonterminals = nonterminals;
+        v.terminals = terminals;
+        v.productions = lhs.size();
+        v.start = start;
+        v.cells = cells.data();
+        v.lhs = lhs.data();
+        v.rhs_offsets = rhs_offsets.data();
+        v.rhs_symbols = rhs_symbols.data();
+        return v;
+    }
+};
+
+// Symbol names laid out as flat arrays: a length-prefixed offset table
+// into one character blob, and an open-addressing hash from names to
+// indexes. Flat so it can be written to a table file and used in place.
+struct NameTableView {
+    uint32_t count = 0;
+    uint32_t mask = 0;                     // slot count - 1 (a power of two minus one)
+    const uint32_t* offsets = nullptr;     // name i is chars[offsets[i] .. offsets[i + 1])
+    const char* chars = nullptr;
+    const uint32_t* slots = nullptr;       // index + 1, or 0 for an empty slot
+
+    static uint64_t hash(std::string_view text) {
+        uint64_t h = 1469598103934665603ull;   // FNV-1a
+        for (unsigned char c : text) h = (h ^ c) * 1099511628211ull;
+        return h;
+    }
+
+    std::string_view name(uint32_t i) const {
+        return std::string_view(chars + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    // Index of the name, or -1
+    int find(std::string_view text) const {
+        if (!slots) return -1;
+        for (uint64_t s = hash(text) & mask;; s = (s + 1) & mask) {
+            uint32_t entry = slots[s];
+            if (entry == 0) return -1;
+            if (name(entry - 1) == text) return entry - 1;
+        }
+    }
+};
+
+struct NameTable {
+    std::vector<uint32_t> offsets;
+    std::string chars;
+    std::vector<uint32_t> slots;
+
+    // Indexes follow the order of names; only names[hashed_from..] are
+    // hashed, so "$" (terminal 0) can be kept out of the lookup
+    static NameTable build(const std::vector<std::string>& names, size_t hashed_from = 0) {
+        NameTable table;
+        table.offsets.push_back(0);
+        for (const std::string& name : names) {
+            table.chars += name;
+            table.offsets.push_back(table.chars.size());
+        }
+        size_t size = 8;
+        while (size < names.size() * 2) size *= 2;
+        table.slots.assign(size, 0);
+        NameTableView v = table.view();
+        for (size_t i = hashed_from; i < names.size(); ++i) {
+            if (v.find(names[i]) >= 0) continue;
+            uint64_t s = NameTableView::hash(names[i]) & v.mask;
+            while (table.slots[s]) s = (s + 1) & v.mask;
+            table.slots[s] = i + 1;
+        }
+        return table;
+    }
+
+    NameTableView view() const {
+        NameTableView v;
+        v.count = offsets.size() - 1;
+        v.mask = slots.size() - 1;
+        v.offsets = offsets.data();
+        v.chars = chars.data();
+        v.slots = slots.data();
+        return v;
+    }
+};
+
+inline NameTable terminal_names(const Grammar& g) {
+    std::vector<std::string> names;
+    for (int symbol : g.terminals) names.push_back(g.name(symbol));
+    return NameTable::build(names, 1);
+}
+
+inline NameTable nonterminal_names(const Grammar& g) {
+    std::vector<std::string> names;
+    for (int symbol : g.nonterminals) names.push_back(g.name(symbol));
+    return NameTable::build(names);
+}
+
+// Reads whitespace separated tokens from a file in large blocks and maps
+// them to terminal indexes. Token text is looked up in place, never copied,
+// except for a token that straddles two blocks.
+class TokenReader {
+    FILE* in;
+    std::vector<char> buffer;
+    size_t pos = 0, end = 0;
+    bool eof = false;
+    NameTable owned;         // only used when built from a Grammar
+    NameTableView lookup;
+    size_t count = 0;
+
+    // Moves the unread tail to the front and fills the rest of the buffer
+    bool refill() {
+        if (eof) return false;
+        memmove(buffer.data(), buffer.data() + pos, end - pos);
+        end -= pos;
+        pos = 0;
+        if (end == buffer.size()) buffer.resize(buffer.size() * 2);   // token longer than a block
+        size_t got = fread(buffer.data() + end, 1, buffer.size() - end, in);
+        if (got == 0) eof = true;
+        end += got;
+        return got > 0;
+    }
+
+    static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+public:
+    std::string_view last;   // text of the most recent token
+
+    // Terminal index 0 ("$") is returned at end of input
+    TokenReader(FILE* file, const Grammar& g, size_t block = 1 << 20)
+        : in(file), buffer(block), owned(terminal_names(g)), lookup(owned.view()) {}
+
+    // Uses an existing name table, e.g. one mapped from a table file
+    TokenReader(FILE* file, const NameTableView& names, size_t block = 1 << 20)
+        : in(file), buffer(block), lookup(names) {}
+
+    TokenReader(const TokenReader&) = delete;
+    TokenReader& operator=(const TokenReader&) = delete;
+
+    // Next terminal index, 0 at end of input, -1 for a token the grammar
+    // does not know
+    int next() {
+        for (;;) {
+            while (pos < end && is_space(buffer[pos])) pos++;
+            if (pos < end) break;
+            if (!refill()) {
+                last = std::string_view();
+                return 0;
+            }
+        }
+        size_t begin = pos;
+        for (;;) {
+            while (pos < end && !is_space(buffer[pos])) pos++;
+            if (pos < end) break;
+            // Keep the partial token and read more; refill() moves it to the front
+            pos = begin;
+            bool more = refill();
+            begin = pos;
+            if (!more) {
+                pos = end;
+                break;
+            }
+        }
+        count++;
+        last = std::string_view(buffer.data() + begin, pos - begin);
+        return lookup.find(last);
+    }
+
+    size_t tokens() const { return count; }
+};
+
+struct LL1ParseResult {
+    bool accepted = false;
+    size_t tokens = 0;          // tokens consumed, not counting "$"
+    int expected = 0;           // on error: the stack symbol that could not match (encoded)
+    int found = 0;              // on error: the terminal read, -1 if unknown
+};
+
+// Predictive parser with an explicit stack; it never recurses, so input
+// nesting depth is limited only by memory. on_production(p) is called for
+// every expansion, which yields the leftmost derivation.
+class LL1Parser {
+    LL1TableView table;
+    std::vector<int32_t> stack;
+
+public:
+    explicit LL1Parser(const LL1TableView& view) : table(view) {}
+
+    template <class TokenSource, class OnProduction>
+    LL1ParseResult parse(TokenSource& tokens, OnProduction on_production) {
+        LL1ParseResult result;
+        stack.clear();
+        stack.push_back(0);             // $
+        stack.push_back(~table.start);
+
+        int token = tokens.next();
+        const int32_t* cells = table.cells;
+        const int32_t terminals = table.terminals;
+
+        while (token >= 0) {
+            int32_t top = stack.back();
+            if (top >= 0) {
+                if (top != token) break;
+                stack.pop_back();
+                if (token == 0) {
+                    result.accepted = true;
+                    return result;
+                }
+                result.tokens++;
+                token = tokens.next();
+                continue;
+            }
+
+            int32_t p = cells[size_t(~top) * terminals + token];
+            if (p < 0) break;
+            stack.pop_back();
+            on_production(p);
+            for (int32_t i = table.rhs_offsets[p + 1]; i-- > table.rhs_offsets[p];) {
+                stack.push_back(table.rhs_symbols[i]);
+            }
+        }
+
+        result.expected = stack.back();
+        result.found = token;
+        return result;
+    }
+
+    template <class TokenSource>
+    LL1ParseResult parse(TokenSource& tokens) {
+        return parse(tokens, [](int32_t) {});
+    }
+};
+
+#endif
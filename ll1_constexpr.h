@@ -0,0 +1,283 @@
+#ifndef LL1_CONSTEXPR_H
+#define LL1_CONSTEXPR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+#include "ll1.h"
+
+// LL(1) tables computed by the compiler for grammars fixed at build time.
+//
+// A grammar is a type with
+//
+//     static constexpr int32_t terminals;      // including "$" at index 0
+//     static constexpr int32_t nonterminals;
+//     static constexpr int32_t start;
+//     static constexpr ll1c::Rule rules[];
+//
+// using the symbol encoding of ll1.h (terminal t as t, non-terminal n as
+// ll1c::nt(n) == ~n). StaticLL1<G>::tables then holds nullable, FIRST,
+// FOLLOW and the parse table as static constexpr arrays, and an LL(1)
+// conflict is a compile error naming the non-terminal and terminal.
+namespace ll1c {
+
+constexpr int max_rhs = 8;
+
+constexpr int32_t nt(int32_t n) { return ~n; }
+
+struct Rule {
+    int32_t lhs = 0;
+    int32_t length = 0;
+    int32_t rhs[max_rhs] = {};
+
+    constexpr Rule(int32_t left, std::initializer_list<int32_t> symbols) : lhs(left) {
+        for (int32_t symbol : symbols) {
+            if (length == max_rhs) throw "right-hand side longer than ll1c::max_rhs";
+            rhs[length++] = symbol;
+        }
+    }
+};
+
+template <int NT, int T, int P>
+struct Tables {
+    static constexpr int words = (T + 63) / 64;
+
+    bool nullable[NT] = {};
+    uint64_t first[NT][words] = {};
+    uint64_t follow[NT][words] = {};
+    int32_t cells[NT * T] = {};
+    int32_t lhs[P] = {};
+    int32_t rhs_offsets[P + 1] = {};
+    int32_t rhs_symbols[P * max_rhs + 1] = {};
+
+    // First conflicting cell, or -1
+    int32_t conflict_nonterminal = -1;
+    int32_t conflict_terminal = -1;
+};
+
+template <int W>
+constexpr bool unite(uint64_t (&dst)[W], const uint64_t (&src)[W]) {
+    bool grew = false;
+    for (int i = 0; i < W; ++i) {
+        uint64_t merged = dst[i] | src[i];
+        grew |= merged != dst[i];
+        dst[i] = merged;
+    }
+    return grew;
+}
+
+template <int W>
+constexpr bool insert(uint64_t (&row)[W], int bit) {
+    uint64_t mask = uint64_t(1) << (bit & 63);
+    if (row[bit >> 6] & mask) return false;
+    row[bit >> 6] |= mask;
+    return true;
+}
+
+template <class G>
+constexpr int production_count() { return sizeof(G::rules) / sizeof(Rule); }
+
+// Plain fixpoint iteration: build-time grammars are small, and this runs
+// once inside the compiler
+template <class G>
+constexpr auto build() {
+    constexpr int NT = G::nonterminals, T = G::terminals, P = production_count<G>();
+    Tables<NT, T, P> t{};
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int p = 0; p < P; ++p) {
+            const Rule& rule = G::rules[p];
+            bool all_nullable = true;
+            for (int i = 0; i < rule.length && all_nullable; ++i) {
+                int32_t symbol = rule.rhs[i];
+                if (symbol >= 0) {
+                    changed |= insert(t.first[rule.lhs], symbol);
+                    all_nullable = false;
+                } else {
+                    changed |= unite(t.first[rule.lhs], t.first[~symbol]);
+                    all_nullable = t.nullable[~symbol];
+                }
+            }
+            if (all_nullable && !t.nullable[rule.lhs]) {
+                t.nullable[rule.lhs] = true;
+                changed = true;
+            }
+        }
+    }
+
+    insert(t.follow[G::start], 0);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int p = 0; p < P; ++p) {
+            const Rule& rule = G::rules[p];
+            for (int i = 0; i < rule.length; ++i) {
+                if (rule.rhs[i] >= 0) continue;
+                int32_t b = ~rule.rhs[i];
+                bool rest_nullable = true;
+                for (int j = i + 1; j < rule.length && rest_nullable; ++j) {
+                    int32_t symbol = rule.rhs[j];
+                    if (symbol >= 0) {
+                        changed |= insert(t.follow[b], symbol);
+                        rest_nullable = false;
+                    } else {
+                        changed |= unite(t.follow[b], t.first[~symbol]);
+                        rest_nullable = t.nullable[~symbol];
+                    }
+                }
+                if (rest_nullable) changed |= unite(t.follow[b], t.follow[rule.lhs]);
+            }
+        }
+    }
+
+    for (int c = 0; c < NT * T; ++c) t.cells[c] = -1;
+    for (int p = 0; p < P; ++p) {
+        const Rule& rule = G::rules[p];
+        uint64_t predict[Tables<NT, T, P>::words] = {};
+        bool all_nullable = true;
+        for (int i = 0; i < rule.length && all_nullable; ++i) {
+            int32_t symbol = rule.rhs[i];
+            if (symbol >= 0) {
+                insert(predict, symbol);
+                all_nullable = false;
+            } else {
+                unite(predict, t.first[~symbol]);
+                all_nullable = t.nullable[~symbol];
+            }
+        }
+        if (all_nullable) unite(predict, t.follow[rule.lhs]);
+
+        for (int terminal = 0; terminal < T; ++terminal) {
+            if (!((predict[terminal >> 6] >> (terminal & 63)) & 1)) continue;
+            int32_t& cell = t.cells[rule.lhs * T + terminal];
+            if (cell >= 0 && t.conflict_nonterminal < 0) {
+                t.conflict_nonterminal = rule.lhs;
+                t.conflict_terminal = terminal;
+            }
+            cell = p;
+        }
+
+        t.lhs[p] = rule.lhs;
+        t.rhs_offsets[p + 1] = t.rhs_offsets[p] + rule.length;
+        for (int i = 0; i < rule.length; ++i) t.rhs_symbols[t.rhs_offsets[p] + i] = rule.rhs[i];
+    }
+    return t;
+}
+
+// Never defined: instantiating it makes the compiler print the conflict
+template <int32_t NonTerminal, int32_t Terminal>
+struct LL1_conflict_at;
+
+template <int32_t NonTerminal, int32_t Terminal>
+constexpr bool no_conflict() {
+    if constexpr (NonTerminal >= 0) {
+        return sizeof(LL1_conflict_at<NonTerminal, Terminal>) == 0;
+    } else {
+        return true;
+    }
+}
+
+}  // namespace ll1c
+
+template <class G>
+struct StaticLL1 {
+    static constexpr auto tables = ll1c::build<G>();
+    static_assert(ll1c::no_conflict<tables.conflict_nonterminal, tables.conflict_terminal>(),
+                  "grammar is not LL(1)");
+
+    // The constexpr tables as a view for the generic LL1Parser
+    static LL1TableView view() {
+        LL1TableView v;
+        v.nonterminals = G::nonterminals;
+        v.terminals = G::terminals;
+        v.productions = ll1c::production_count<G>();
+        v.start = G::start;
+        v.cells = tables.cells;
+        v.lhs = tables.lhs;
+        v.rhs_offsets = tables.rhs_offsets;
+        v.rhs_symbols = tables.rhs_symbols;
+        return v;
+    }
+};
+
+// Parser specialized per production: the lookahead selects a function
+// from a constexpr table per non-terminal, and each production pushes its
+// right-hand side as an inlined sequence of constants. A production that
+// starts with a terminal consumes it at once, since the table only chose
+// it on that lookahead.
+//
+// Lexer:   int peek() (terminal index, 0 at end, -1 unknown), void advance()
+// Handler: void on_production(int32_t p), called before p is expanded
+//
+// Pending symbols live on an explicit stack, as in LL1Parser, so deep
+// nesting is bounded by memory rather than by the C++ stack.
+template <class G, class Lexer, class Handler>
+class StaticParser {
+    typedef StaticLL1<G> Table;
+    typedef std::vector<int32_t> Stack;
+    typedef void (*Expander)(Lexer&, Handler&, Stack&);
+
+    // Pushes rhs[length - 1] down to rhs[length - sizeof...(I)]
+    template <int32_t P, size_t... I>
+    static void push(Stack& stack, std::index_sequence<I...>) {
+        constexpr int32_t length = G::rules[P].length;
+        (stack.push_back(G::rules[P].rhs[length - 1 - I]), ...);
+    }
+
+    template <int32_t P>
+    static void production(Lexer& lex, Handler& handler, Stack& stack) {
+        handler.on_production(P);
+        constexpr int32_t length = G::rules[P].length;
+        if constexpr (length > 0 && G::rules[P].rhs[0] >= 0) {
+            lex.advance();
+            push<P>(stack, std::make_index_sequence<length - 1>());
+        } else {
+            push<P>(stack, std::make_index_sequence<length>());
+        }
+    }
+
+    template <int32_t P>
+    static constexpr Expander expander() {
+        if constexpr (P < 0) {
+            return nullptr;
+        } else {
+            return &production<P>;
+        }
+    }
+
+    template <int32_t N, size_t... T>
+    static constexpr std::array<Expander, sizeof...(T)> row(std::index_sequence<T...>) {
+        return {{expander<Table::tables.cells[N * G::terminals + T]>()...}};
+    }
+
+    template <size_t... N>
+    static constexpr std::array<std::array<Expander, G::terminals>, sizeof...(N)> rows(std::index_sequence<N...>) {
+        return {{row<N>(std::make_index_sequence<G::terminals>())...}};
+    }
+
+public:
+    static bool parse(Lexer& lex, Handler& handler) {
+        static constexpr auto expanders = rows(std::make_index_sequence<G::nonterminals>());
+        Stack stack{ll1c::nt(G::start)};
+        while (!stack.empty()) {
+            int32_t symbol = stack.back();
+            stack.pop_back();
+            int token = lex.peek();
+            if (symbol >= 0) {
+                if (token != symbol) return false;
+                lex.advance();
+                continue;
+            }
+            if (token < 0) return false;
+            Expander expand = expanders[~symbol][token];
+            if (!expand) return false;
+            expand(lex, handler, stack);
+        }
+        return lex.peek() == 0;
+    }
+};
+
+#endif
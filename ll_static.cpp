@@ -0,0 +1,161 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include "ll1_constexpr.h"
+
+using namespace std;
+
+// Expression grammar fixed at build time; its FIRST/FOLLOW sets and LL(1)
+// table are computed by the compiler (see ll1_constexpr.h)
+//
+// E → T X        X → + T X | ε
+// T → F Y        Y → * F Y | ε
+// F → ( E ) | id
+
+enum Terminal : int32_t { END, PLUS, STAR, LPAREN, RPAREN, ID, TERMINAL_COUNT };
+enum NonTerminal : int32_t { E, X, T, Y, F, NONTERMINAL_COUNT };
+
+using ll1c::nt;
+
+struct ExprGrammar {
+    static constexpr int32_t terminals = TERMINAL_COUNT;
+    static constexpr int32_t nonterminals = NONTERMINAL_COUNT;
+    static constexpr int32_t start = E;
+    static constexpr ll1c::Rule rules[] = {
+        {E, {nt(T), nt(X)}},
+        {X, {PLUS, nt(T), nt(X)}},
+        {X, {}},
+        {T, {nt(F), nt(Y)}},
+        {Y, {STAR, nt(F), nt(Y)}},
+        {Y, {}},
+        {F, {LPAREN, nt(E), RPAREN}},
+        {F, {ID}},
+    };
+};
+
+typedef StaticLL1<ExprGrammar> ExprTable;
+
+// Checked by the compiler: no table construction happens at startup
+static_assert(ExprTable::tables.cells[int32_t(E) * int32_t(TERMINAL_COUNT) + int32_t(ID)] == 0, "E -> T X on id");
+static_assert(ExprTable::tables.cells[int32_t(X) * int32_t(TERMINAL_COUNT) + int32_t(RPAREN)] == 2, "X -> ε on )");
+static_assert(ExprTable::tables.nullable[Y] && !ExprTable::tables.nullable[F], "nullable");
+
+// Adding {F, {ID, PLUS}} to the rules fails to compile with
+// "incomplete type ll1c::LL1_conflict_at<4, 5>" (F on id).
+
+const char* terminalNames[] = {"$", "+", "*", "(", ")", "id"};
+const char* nonTerminalNames[] = {"E", "X", "T", "Y", "F"};
+
+// Hand-written scanner over an in-memory buffer; any run of letters,
+// digits or '_' is an id
+class ExprLexer {
+    const char* p;
+    const char* end;
+    int current = 0;
+
+    void scan() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+        if (p == end) {
+            current = END;
+            return;
+        }
+        switch (*p) {
+            case '+': current = PLUS; p++; return;
+            case '*': current = STAR; p++; return;
+            case '(': current = LPAREN; p++; return;
+            case ')': current = RPAREN; p++; return;
+        }
+        if (isalnum((unsigned char)*p) || *p == '_') {
+            while (p < end && (isalnum((unsigned char)*p) || *p == '_')) p++;
+            current = ID;
+            return;
+        }
+        current = -1;
+    }
+
+public:
+    size_t tokens = 0;
+
+    ExprLexer(const string& text) : p(text.data()), end(text.data() + text.size()) { scan(); }
+
+    int peek() const { return current; }
+    void advance() {
+        tokens++;
+        scan();
+    }
+    // TokenSource interface of ll1.h
+    int next() {
+        int token = current;
+        if (token > 0) advance();
+        return token;
+    }
+};
+
+struct CountingHandler {
+    size_t productions = 0;
+    void on_production(int32_t) { productions++; }
+};
+
+void printTable() {
+    cout << "LL(1) Parsing Table (computed at compile time):\n";
+    for (int n = 0; n < NONTERMINAL_COUNT; n++) {
+        cout << nonTerminalNames[n] << "  | ";
+        for (int t = 1; t <= TERMINAL_COUNT; t++) {
+            int terminal = t % TERMINAL_COUNT;
+            int p = ExprTable::tables.cells[n * TERMINAL_COUNT + terminal];
+            cout << terminalNames[terminal] << ": ";
+            if (p < 0) {
+                cout << "-";
+            } else {
+                const ll1c::Rule& rule = ExprGrammar::rules[p];
+                cout << nonTerminalNames[rule.lhs] << "->";
+                if (rule.length == 0) cout << "ε";
+                for (int i = 0; i < rule.length; i++) {
+                    int32_t s = rule.rhs[i];
+                    cout << (s >= 0 ? terminalNames[s] : nonTerminalNames[~s]);
+                }
+            }
+            cout << (terminal ? " | " : "\n");
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    printTable();
+
+    string input = "a + b * ( c + d )";
+    if (argc > 1) {
+        ifstream file(argv[1], ios::binary);
+        if (!file) {
+            cout << "Error: cannot open " << argv[1] << "\n";
+            return 1;
+        }
+        stringstream contents;
+        contents << file.rdbuf();
+        input = contents.str();
+    }
+
+    // Specialized per-production dispatch on an explicit stack
+    ExprLexer lexer(input);
+    CountingHandler handler;
+    auto start = chrono::steady_clock::now();
+    bool accepted = StaticParser<ExprGrammar, ExprLexer, CountingHandler>::parse(lexer, handler);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "\nStatic parser: " << (accepted ? "accepted" : "rejected") << ", "
+         << lexer.tokens << " tokens, " << handler.productions << " expansions, "
+         << (seconds > 0 ? lexer.tokens / seconds : 0) << " tokens/sec\n";
+
+    // Generic table-driven parser over the same constexpr table
+    ExprLexer tokens(input);
+    LL1Parser parser(ExprTable::view());
+    start = chrono::steady_clock::now();
+    LL1ParseResult result = parser.parse(tokens);
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Table parser:  " << (result.accepted ? "accepted" : "rejected") << ", "
+         << result.tokens << " tokens, "
+         << (seconds > 0 ? result.tokens / seconds : 0) << " tokens/sec\n";
+
+    return accepted && result.accepted ? 0 : 1;
+}
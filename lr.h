@@ -0,0 +1,451 @@
+#ifndef LR_H
+#define LR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "grammar.h"
+
+// LR(0) automaton and LR ACTION/GOTO tables.
+//
+// Symbols use the encoding of ll1.h: terminal t as t ("$" is 0) and
+// non-terminal n as ~n. The grammar is augmented with S' → S, where S' is
+// the last non-terminal and S' → S the last production.
+//
+// An item is one integer: item_base[p] + dot. A state is identified by its
+// kernel, the sorted array of its kernel items; closure items are derived
+// on demand and never stored.
+
+class LRAutomaton {
+public:
+    int32_t terminals = 0;
+    int32_t nonterminals = 0;            // including S'
+    int32_t accept_production = 0;       // S' → S
+
+    // Productions, with S' → S appended
+    std::vector<int32_t> lhs;
+    std::vector<int32_t> rhs_offsets;    // size productions + 1
+    std::vector<int32_t> rhs_symbols;
+    std::vector<int32_t> rule_offsets;   // non-terminal -> its productions in rule_list
+    std::vector<int32_t> rule_list;
+
+    // Items
+    std::vector<int32_t> item_base;      // production -> item with the dot at 0
+    std::vector<int32_t> item_production;
+
+    // States: kernels and outgoing transitions, both flat. Transitions of a
+    // state are sorted by symbol index (terminals, then non-terminals).
+    std::vector<int32_t> kernel_offsets; // size states + 1
+    std::vector<int32_t> kernel_items;
+    std::vector<int32_t> transition_offsets;
+    std::vector<int32_t> transition_symbols;
+    std::vector<int32_t> transition_targets;
+    std::vector<int32_t> accessing_symbol;   // state -> symbol on its incoming edges, state 0 has none
+
+    int32_t productions() const { return lhs.size(); }
+    int32_t states() const { return kernel_offsets.size() - 1; }
+    int32_t length(int32_t p) const { return rhs_offsets[p + 1] - rhs_offsets[p]; }
+    int32_t dot(int32_t item) const { return item - item_base[item_production[item]]; }
+    bool at_end(int32_t item) const { return dot(item) == length(item_production[item]); }
+
+    // Symbol after the dot; only valid when !at_end(item)
+    int32_t next_symbol(int32_t item) const {
+        return rhs_symbols[rhs_offsets[item_production[item]] + dot(item)];
+    }
+
+    // Dense index of an encoded symbol: terminals first, then non-terminals
+    int32_t symbol_index(int32_t symbol) const { return symbol >= 0 ? symbol : terminals + ~symbol; }
+
+    // Index of the transition on symbol out of state, or -1
+    int32_t transition(int32_t state, int32_t symbol) const {
+        auto first = transition_symbols.begin() + transition_offsets[state];
+        auto last = transition_symbols.begin() + transition_offsets[state + 1];
+        int32_t index = symbol_index(symbol);
+        auto it = std::lower_bound(first, last, index, [&](int32_t s, int32_t i) { return symbol_index(s) < i; });
+        if (it == last || *it != symbol) return -1;
+        return it - transition_symbols.begin();
+    }
+
+    // Target of the transition on symbol, or -1
+    int32_t go(int32_t state, int32_t symbol) const {
+        int32_t e = transition(state, symbol);
+        return e < 0 ? -1 : transition_targets[e];
+    }
+
+    static LRAutomaton build(const Grammar& g);
+};
+
+// Computes closures of states with a reusable marker array
+class LRClosure {
+    const LRAutomaton& a;
+    std::vector<uint32_t> marks;   // per non-terminal: epoch in which it was expanded
+    uint32_t epoch = 0;
+
+public:
+    std::vector<int32_t> items;
+
+    explicit LRClosure(const LRAutomaton& automaton) : a(automaton), marks(automaton.nonterminals, 0) {}
+
+    // Kernel items first, then the dot-0 items they predict
+    const std::vector<int32_t>& of(int32_t state) {
+        if (++epoch == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch = 1;
+        }
+        items.assign(a.kernel_items.begin() + a.kernel_offsets[state],
+                     a.kernel_items.begin() + a.kernel_offsets[state + 1]);
+        for (size_t i = 0; i < items.size(); ++i) {
+            int32_t item = items[i];
+            if (a.at_end(item)) continue;
+            int32_t symbol = a.next_symbol(item);
+            if (symbol >= 0 || marks[~symbol] == epoch) continue;
+            marks[~symbol] = epoch;
+            for (int32_t r = a.rule_offsets[~symbol]; r < a.rule_offsets[~symbol + 1]; ++r) {
+                items.push_back(a.item_base[a.rule_list[r]]);
+            }
+        }
+        return items;
+    }
+};
+
+// Canonical LR(0) collection. New kernels are looked up in an open
+// addressing table keyed on the kernel array, so every goto costs one hash
+// of its kernel rather than a comparison against existing states.
+inline LRAutomaton LRAutomaton::build(const Grammar& g) {
+    LRAutomaton a;
+    a.terminals = g.terminals.size();
+    a.nonterminals = g.nonterminals.size() + 1;
+    int32_t augmented = a.nonterminals - 1;
+
+    a.rhs_offsets.push_back(0);
+    for (const Production& production : g.productions) {
+        a.lhs.push_back(g.nt_of[production.lhs]);
+        for (int symbol : production.rhs) {
+            int nt = g.nt_of[symbol];
+            a.rhs_symbols.push_back(nt >= 0 ? ~nt : g.term_of[symbol]);
+        }
+        a.rhs_offsets.push_back(a.rhs_symbols.size());
+    }
+    a.accept_production = a.lhs.size();
+    a.lhs.push_back(augmented);
+    if (!g.nonterminals.empty()) a.rhs_symbols.push_back(~g.start);
+    a.rhs_offsets.push_back(a.rhs_symbols.size());
+
+    a.rule_offsets.assign(a.nonterminals + 1, 0);
+    for (int32_t nt : a.lhs) a.rule_offsets[nt + 1]++;
+    for (int32_t n = 0; n < a.nonterminals; ++n) a.rule_offsets[n + 1] += a.rule_offsets[n];
+    a.rule_list.resize(a.lhs.size());
+    std::vector<int32_t> fill(a.rule_offsets.begin(), a.rule_offsets.end() - 1);
+    for (int32_t p = 0; p < a.productions(); ++p) a.rule_list[fill[a.lhs[p]]++] = p;
+
+    for (int32_t p = 0; p < a.productions(); ++p) {
+        a.item_base.push_back(a.item_production.size());
+        a.item_production.insert(a.item_production.end(), a.length(p) + 1, p);
+    }
+
+    // Kernel hash table of state ids + 1, kept at most half full
+    std::vector<uint64_t> hashes;
+    std::vector<int32_t> table(64, 0);
+    auto kernel_hash = [](const int32_t* first, const int32_t* last) {
+        uint64_t h = 0x9e3779b97f4a7c15ull;
+        for (; first != last; ++first) h = (h ^ uint32_t(*first)) * 0x100000001b3ull + (h >> 29);
+        return h;
+    };
+    auto insert_slot = [&](uint64_t h, int32_t id) {
+        size_t mask = table.size() - 1;
+        size_t s = h & mask;
+        while (table[s]) s = (s + 1) & mask;
+        table[s] = id + 1;
+    };
+    // State for the kernel, added if new
+    auto find_or_add = [&](const std::vector<int32_t>& kernel) {
+        uint64_t h = kernel_hash(kernel.data(), kernel.data() + kernel.size());
+        size_t mask = table.size() - 1;
+        for (size_t s = h & mask; table[s]; s = (s + 1) & mask) {
+            int32_t id = table[s] - 1;
+            if (hashes[id] != h) continue;
+            const int32_t* first = a.kernel_items.data() + a.kernel_offsets[id];
+            const int32_t* last = a.kernel_items.data() + a.kernel_offsets[id + 1];
+            if (std::equal(first, last, kernel.begin(), kernel.end())) return id;
+        }
+        int32_t id = a.kernel_offsets.size() - 1;
+        a.kernel_items.insert(a.kernel_items.end(), kernel.begin(), kernel.end());
+        a.kernel_offsets.push_back(a.kernel_items.size());
+        hashes.push_back(h);
+        if (hashes.size() * 2 > table.size()) {
+            table.assign(table.size() * 2, 0);
+            for (int32_t i = 0; i < int32_t(hashes.size()); ++i) insert_slot(hashes[i], i);
+        } else {
+            insert_slot(h, id);
+        }
+        return id;
+    };
+
+    a.kernel_offsets.push_back(0);
+    find_or_add({a.item_base[a.accept_production]});
+    a.accessing_symbol.push_back(0);
+
+    // Successor kernels, bucketed by symbol index
+    std::vector<std::vector<int32_t>> buckets(a.terminals + a.nonterminals);
+    std::vector<int32_t> touched;
+    LRClosure closure(a);
+
+    a.transition_offsets.push_back(0);
+    for (int32_t state = 0; state < a.states(); ++state) {
+        for (int32_t item : closure.of(state)) {
+            if (a.at_end(item)) continue;
+            int32_t index = a.symbol_index(a.next_symbol(item));
+            if (buckets[index].empty()) touched.push_back(index);
+            buckets[index].push_back(item + 1);
+        }
+        std::sort(touched.begin(), touched.end());
+        for (int32_t index : touched) {
+            std::vector<int32_t>& kernel = buckets[index];
+            std::sort(kernel.begin(), kernel.end());
+            int32_t before = a.states();
+            int32_t target = find_or_add(kernel);
+            int32_t symbol = index < a.terminals ? index : ~(index - a.terminals);
+            if (target == before) a.accessing_symbol.push_back(symbol);
+            a.transition_symbols.push_back(symbol);
+            a.transition_targets.push_back(target);
+            kernel.clear();
+        }
+        touched.clear();
+        a.transition_offsets.push_back(a.transition_symbols.size());
+    }
+    return a;
+}
+
+// ---------------------------------------------------------------------------
+// ACTION/GOTO tables
+// ---------------------------------------------------------------------------
+
+// ACTION cell encoding: 0 is an error, s + 1 shifts to state s and ~p
+// reduces by production p. Reducing by S' → S means accept.
+struct LRConflict {
+    int32_t state;
+    int32_t terminal;
+    int32_t kept;       // action left in the table
+    int32_t dropped;    // action that lost
+    bool shift_reduce() const { return kept > 0 || dropped > 0; }
+};
+
+struct LRTables {
+    int32_t states = 0;
+    int32_t terminals = 0;
+    int32_t nonterminals = 0;            // including S'
+    int32_t accept_production = 0;
+    std::vector<int32_t> action;         // [state * terminals + t]
+    std::vector<int32_t> go_to;          // [state * nonterminals + n] -> state or -1
+    std::vector<int32_t> lhs;            // production -> non-terminal
+    std::vector<int32_t> rhs_length;     // production -> symbols popped on reduce
+    std::vector<LRConflict> conflicts;
+
+    int32_t action_at(int32_t state, int32_t t) const { return action[size_t(state) * terminals + t]; }
+    int32_t goto_at(int32_t state, int32_t n) const { return go_to[size_t(state) * nonterminals + n]; }
+    size_t bytes() const {
+        return (action.size() + go_to.size() + lhs.size() + rhs_length.size()) * sizeof(int32_t);
+    }
+};
+
+// Fills ACTION/GOTO from the automaton. lookahead(state, item) returns the
+// terminal bit row on which the completed item reduces. Conflicts are
+// resolved like yacc, shift over reduce and the earlier production between
+// two reductions, and every one is recorded.
+template <class Lookahead>
+LRTables build_lr_tables(const LRAutomaton& a, Lookahead lookahead) {
+    LRTables t;
+    t.states = a.states();
+    t.terminals = a.terminals;
+    t.nonterminals = a.nonterminals;
+    t.accept_production = a.accept_production;
+    t.action.assign(size_t(t.states) * t.terminals, 0);
+    t.go_to.assign(size_t(t.states) * t.nonterminals, -1);
+    t.lhs = a.lhs;
+    for (int32_t p = 0; p < a.productions(); ++p) t.rhs_length.push_back(a.length(p));
+
+    size_t words = words_for(a.terminals);
+    LRClosure closure(a);
+    for (int32_t state = 0; state < t.states; ++state) {
+        int32_t* row = t.action.data() + size_t(state) * t.terminals;
+        for (int32_t e = a.transition_offsets[state]; e < a.transition_offsets[state + 1]; ++e) {
+            int32_t symbol = a.transition_symbols[e];
+            if (symbol >= 0) {
+                row[symbol] = a.transition_targets[e] + 1;
+            } else {
+                t.go_to[size_t(state) * t.nonterminals + ~symbol] = a.transition_targets[e];
+            }
+        }
+
+        for (int32_t item : closure.of(state)) {
+            if (!a.at_end(item)) continue;
+            int32_t reduce = ~a.item_production[item];
+            bits_for_each(lookahead(state, item), words, [&](int terminal) {
+                int32_t& cell = row[terminal];
+                if (cell == 0) {
+                    cell = reduce;
+                    return;
+                }
+                // Shifts are positive; between reductions the smaller production wins
+                int32_t kept = cell > 0 || ~cell < ~reduce ? cell : reduce;
+                int32_t dropped = kept == cell ? reduce : cell;
+                if (cell != reduce) t.conflicts.push_back({state, terminal, kept, dropped});
+                cell = kept;
+            });
+        }
+    }
+    return t;
+}
+
+// SLR(1): a completed item A → α· reduces on FOLLOW(A), and S' → S· on $
+inline LRTables build_slr_tables(const LRAutomaton& a, const BitMatrix& follow) {
+    std::vector<uint64_t> end_only(words_for(a.terminals), 0);
+    bits_set(end_only.data(), 0);
+    return build_lr_tables(a, [&](int32_t, int32_t item) -> const uint64_t* {
+        int32_t nt = a.lhs[a.item_production[item]];
+        return nt == a.nonterminals - 1 ? end_only.data() : follow.row(nt);
+    });
+}
+
+// ---------------------------------------------------------------------------
+// LALR(1) lookaheads
+// ---------------------------------------------------------------------------
+
+// LALR(1) lookaheads on the LR(0) automaton, after DeRemer and Pennello,
+// "Efficient Computation of LALR(1) Look-Ahead Sets" (1982). No LR(1)
+// states are built or merged. For every non-terminal transition x = (p, A):
+//
+//     DR(x)     terminals shifted right after A, out of goto(p, A)
+//     x reads y       y = (goto(p, A), C) with C nullable
+//     x includes y    y = (p', B), B → β A γ, γ nullable, p' -β-> p
+//     Read(x)   = DR(x) ∪ Read(y) for x reads y
+//     Follow(x) = Read(x) ∪ Follow(y) for x includes y
+//
+// and a completed item A → ω· in state q has LA = ∪ Follow(p, A) over the
+// transitions it looks back on (p -ω-> q). Both unions are the digraph
+// problem solve_union_system already handles an SCC at a time. The sets are
+// exact for reduced grammars; a non-terminal that derives no terminal
+// string can add spurious lookaheads.
+class LALRLookaheads {
+public:
+    std::vector<int32_t> reduction_offsets;   // state -> its rows in reduction_items
+    std::vector<int32_t> reduction_items;     // completed items, sorted per state
+    BitMatrix lookaheads;                     // one row per reduction
+
+    // nullable is indexed by non-terminal; S' (the last one) may be missing
+    LALRLookaheads(const LRAutomaton& a, const std::vector<char>& nullable);
+
+    // Lookahead row of a completed item, nullptr if it has none
+    const uint64_t* of(int32_t state, int32_t item) const {
+        auto first = reduction_items.begin() + reduction_offsets[state];
+        auto last = reduction_items.begin() + reduction_offsets[state + 1];
+        auto it = std::lower_bound(first, last, item);
+        if (it == last || *it != item) return nullptr;
+        return lookaheads.row(it - reduction_items.begin());
+    }
+};
+
+inline LALRLookaheads::LALRLookaheads(const LRAutomaton& a, const std::vector<char>& nullable) {
+    auto is_nullable = [&](int32_t nt) { return size_t(nt) < nullable.size() && nullable[nt]; };
+
+    // Dense ids for the non-terminal transitions
+    std::vector<int32_t> id_of(a.transition_symbols.size(), -1);
+    std::vector<int32_t> edge_of;
+    for (size_t e = 0; e < a.transition_symbols.size(); ++e) {
+        if (a.transition_symbols[e] >= 0) continue;
+        id_of[e] = edge_of.size();
+        edge_of.push_back(e);
+    }
+    std::vector<int32_t> source(a.transition_symbols.size());
+    for (int32_t state = 0; state < a.states(); ++state) {
+        for (int32_t e = a.transition_offsets[state]; e < a.transition_offsets[state + 1]; ++e) source[e] = state;
+    }
+    int32_t count = edge_of.size();
+
+    // DR and reads
+    BitMatrix follow(count, a.terminals);
+    std::vector<std::pair<int, int>> edges;
+    for (int32_t x = 0; x < count; ++x) {
+        int32_t r = a.transition_targets[edge_of[x]];
+        for (int32_t e = a.transition_offsets[r]; e < a.transition_offsets[r + 1]; ++e) {
+            int32_t symbol = a.transition_symbols[e];
+            if (symbol >= 0) {
+                bits_set(follow.row(x), symbol);
+            } else if (is_nullable(~symbol)) {
+                edges.push_back({x, id_of[e]});
+            }
+        }
+    }
+    // $ follows the start symbol: S' → ·S in state 0
+    if (a.length(a.accept_production) > 0) {
+        int32_t e = a.transition(0, a.rhs_symbols[a.rhs_offsets[a.accept_production]]);
+        if (e >= 0) bits_set(follow.row(id_of[e]), 0);
+    }
+    Digraph reads = Digraph::from_edges(count, edges);
+    solve_union_system(reads, strongly_connected_components(reads), follow);
+
+    // includes and lookback, found by walking every production of B from p'
+    std::vector<int32_t> nullable_from(a.productions());   // first position of a nullable suffix
+    for (int32_t p = 0; p < a.productions(); ++p) {
+        int32_t i = a.length(p);
+        while (i > 0) {
+            int32_t symbol = a.rhs_symbols[a.rhs_offsets[p] + i - 1];
+            if (symbol >= 0 || !is_nullable(~symbol)) break;
+            i--;
+        }
+        nullable_from[p] = i;
+    }
+
+    edges.clear();
+    std::vector<std::pair<int64_t, int32_t>> lookback;   // ((state << 32) | item, x)
+    for (int32_t x = 0; x < count; ++x) {
+        int32_t from = source[edge_of[x]];
+        int32_t b = ~a.transition_symbols[edge_of[x]];
+        for (int32_t r = a.rule_offsets[b]; r < a.rule_offsets[b + 1]; ++r) {
+            int32_t p = a.rule_list[r];
+            int32_t q = from;
+            for (int32_t i = 0; i < a.length(p); ++i) {
+                int32_t symbol = a.rhs_symbols[a.rhs_offsets[p] + i];
+                int32_t e = a.transition(q, symbol);
+                if (symbol < 0 && i + 1 >= nullable_from[p]) edges.push_back({id_of[e], x});
+                q = a.transition_targets[e];
+            }
+            int32_t item = a.item_base[p] + a.length(p);
+            lookback.push_back({(int64_t(q) << 32) | uint32_t(item), x});
+        }
+    }
+    Digraph includes = Digraph::from_edges(count, edges);
+    solve_union_system(includes, strongly_connected_components(includes), follow);
+
+    // LA per completed item: the union over its lookbacks
+    std::sort(lookback.begin(), lookback.end());
+    size_t rows = 0;
+    for (size_t i = 0; i < lookback.size(); ++i) {
+        if (i == 0 || lookback[i].first != lookback[i - 1].first) rows++;
+    }
+    lookaheads = BitMatrix(rows, a.terminals);
+    reduction_offsets.assign(a.states() + 1, 0);
+    for (size_t i = 0; i < lookback.size(); ++i) {
+        if (i == 0 || lookback[i].first != lookback[i - 1].first) {
+            reduction_items.push_back(int32_t(lookback[i].first));
+            reduction_offsets[(lookback[i].first >> 32) + 1]++;
+        }
+        bits_union(lookaheads.row(reduction_items.size() - 1), follow.row(lookback[i].second), follow.words());
+    }
+    for (int32_t state = 0; state < a.states(); ++state) reduction_offsets[state + 1] += reduction_offsets[state];
+}
+
+// LALR(1): like build_slr_tables, with the lookaheads above
+inline LRTables build_lalr_tables(const LRAutomaton& a, const std::vector<char>& nullable) {
+    LALRLookaheads lalr(a, nullable);
+    std::vector<uint64_t> end_only(words_for(a.terminals), 0);
+    bits_set(end_only.data(), 0);
+    std::vector<uint64_t> none(words_for(a.terminals), 0);
+    return build_lr_tables(a, [&](int32_t state, int32_t item) -> const uint64_t* {
+        if (a.item_production[item] == a.accept_production) return end_only.data();
+        const uint64_t* row = lalr.of(state, item);
+        return row ? row : none.data();
+    });
+}
+
+#endif
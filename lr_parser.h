@@ -0,0 +1,144 @@
+#ifndef LR_PARSER_H
+#define LR_PARSER_H
+
+#include <cstdint>
+#include <vector>
+#include "arena.h"
+#include "lr.h"
+
+// Table-driven shift-reduce parser.
+//
+// Tables is LRTables or PackedLRTables (table_pack.h): anything with
+// action_at(state, t), goto_at(state, n), lhs, rhs_length and
+// accept_production, using the ACTION encoding of lr.h.
+//
+// TokenSource is the interface of ll1.h: int next() returns the next
+// terminal index, 0 at end of input and -1 for an unknown token.
+//
+// Actions decides what a parse produces:
+//
+//     Value shift(int32_t terminal)                        value of the token just read
+//     Value reduce(int32_t p, Value* children, int32_t n)  value of lhs(p) from its n children
+//
+// children points into the parser's value stack and is only valid during
+// the call. reduce can build IR directly, count, or build a tree with
+// ParseTreeBuilder below.
+
+struct LRParseResult {
+    bool accepted = false;
+    size_t tokens = 0;       // tokens shifted
+    int32_t state = 0;       // on error: the state that had no action
+    int32_t found = 0;       // on error: the terminal read, -1 if unknown
+};
+
+template <class Tables, class Value>
+class LRParser {
+    const Tables& tables;
+    // Flat stacks, kept between parses so steady-state parsing does not allocate
+    std::vector<int32_t> states;
+    std::vector<Value> values;
+
+public:
+    explicit LRParser(const Tables& t) : tables(t) {}
+
+    // Value of the start symbol, valid after an accepted parse
+    Value result{};
+
+    template <class TokenSource, class Actions>
+    LRParseResult parse(TokenSource& tokens, Actions& actions) {
+        LRParseResult outcome;
+        states.clear();
+        values.clear();
+        states.push_back(0);
+        values.push_back(Value{});
+
+        int token = tokens.next();
+        while (token >= 0) {
+            int32_t state = states.back();
+            int32_t action = tables.action_at(state, token);
+            if (action > 0) {
+                states.push_back(action - 1);
+                values.push_back(actions.shift(token));
+                outcome.tokens++;
+                token = tokens.next();
+                continue;
+            }
+            if (action == 0) break;
+
+            int32_t p = ~action;
+            if (p == tables.accept_production) {
+                result = values.back();
+                outcome.accepted = true;
+                return outcome;
+            }
+            int32_t n = tables.rhs_length[p];
+            size_t base = values.size() - n;
+            Value value = actions.reduce(p, values.data() + base, n);
+            states.resize(states.size() - n);
+            values.resize(base);
+            states.push_back(tables.goto_at(states.back(), tables.lhs[p]));
+            values.push_back(value);
+        }
+
+        outcome.state = states.back();
+        outcome.found = token;
+        return outcome;
+    }
+};
+
+// Concrete parse tree in an arena. A token node has production -1 and the
+// index of the token in the input; an inner node has its children inline.
+struct ParseNode {
+    int32_t symbol;              // encoded as in lr.h: terminal t, non-terminal ~n
+    int32_t production;          // -1 for a token
+    int32_t token;               // token index, or -1 for an inner node
+    int32_t count;               // number of children
+    const ParseNode* children[1];   // actually count entries
+
+    static size_t size_for(int32_t count) {
+        return sizeof(ParseNode) + sizeof(const ParseNode*) * (count > 1 ? count - 1 : 0);
+    }
+};
+
+// Actions that build a ParseNode tree in an arena; release the arena once
+// the tree has been used
+template <class Tables>
+class ParseTreeBuilder {
+    const Tables& tables;
+    Arena& arena;
+    int32_t next_token = 0;
+
+public:
+    size_t nodes = 0;
+
+    ParseTreeBuilder(const Tables& t, Arena& a) : tables(t), arena(a) {}
+
+    // Starts numbering tokens from 0 again
+    void reset() {
+        next_token = 0;
+        nodes = 0;
+    }
+
+    const ParseNode* shift(int32_t terminal) {
+        ParseNode* node = static_cast<ParseNode*>(arena.allocate(ParseNode::size_for(0), alignof(ParseNode)));
+        node->symbol = terminal;
+        node->production = -1;
+        node->token = next_token++;
+        node->count = 0;
+        nodes++;
+        return node;
+    }
+
+    const ParseNode* reduce(int32_t p, const ParseNode* const* children, int32_t count) {
+        ParseNode* node = static_cast<ParseNode*>(arena.allocate(ParseNode::size_for(count), alignof(ParseNode)));
+        node->symbol = ~tables.lhs[p];
+        node->production = p;
+        node->token = -1;
+        node->count = count;
+        for (int32_t i = 0; i < count; ++i) node->children[i] = children[i];
+        nodes++;
+        return node;
+    }
+};
+
+#endif
@@ -0,0 +1,759 @@
+#ifndef NFA_H
+#define NFA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "grammar.h"
+
+// Subset construction over flat state sets.
+//
+// NFA states are renumbered densely when they are added; transitions are
+// kept as per-state edge arrays sorted by symbol. A DFA state is a sorted
+// array of dense NFA states, interned in a StateSetTable, so checking
+// whether a subset is new costs one hash and at most a few array compares
+// instead of std::set comparisons. Epsilon closures are computed once per
+// NFA state before the construction starts.
+
+// Sorted state sets stored back to back and interned by content. Every set
+// is hashed once when it is looked up; lookups compare the stored hash
+// before the members.
+class StateSetTable {
+    std::vector<int32_t> offsets{0};   // set -> first member, size sets + 1
+    std::vector<int32_t> members;
+    std::vector<uint64_t> hashes;
+    std::vector<int32_t> slots = std::vector<int32_t>(64, 0);   // set id + 1, 0 if empty
+
+    void place(uint64_t h, int32_t id) {
+        size_t mask = slots.size() - 1;
+        size_t s = h & mask;
+        while (slots[s]) s = (s + 1) & mask;
+        slots[s] = id + 1;
+    }
+
+public:
+    static uint64_t hash(const int32_t* first, const int32_t* last) {
+        uint64_t h = 0x9e3779b97f4a7c15ull;
+        for (; first != last; ++first) h = (h ^ uint32_t(*first)) * 0x100000001b3ull + (h >> 29);
+        return h;
+    }
+
+    int32_t size() const { return hashes.size(); }
+    void clear() {
+        offsets.assign(1, 0);
+        members.clear();
+        hashes.clear();
+        std::fill(slots.begin(), slots.end(), 0);
+    }
+    const int32_t* begin(int32_t id) const { return members.data() + offsets[id]; }
+    const int32_t* end(int32_t id) const { return members.data() + offsets[id + 1]; }
+    int32_t count(int32_t id) const { return offsets[id + 1] - offsets[id]; }
+    size_t bytes() const {
+        return (offsets.size() + members.size() + slots.size()) * sizeof(int32_t) + hashes.size() * sizeof(uint64_t);
+    }
+
+    // Id of the set, adding it if new; second is true if it was added
+    std::pair<int32_t, bool> intern(const int32_t* first, const int32_t* last) {
+        return intern(first, last, hash(first, last));
+    }
+
+    // intern() with the hash already computed
+    std::pair<int32_t, bool> intern(const int32_t* first, const int32_t* last, uint64_t h) {
+        size_t mask = slots.size() - 1;
+        for (size_t s = h & mask; slots[s]; s = (s + 1) & mask) {
+            int32_t id = slots[s] - 1;
+            if (hashes[id] == h && std::equal(begin(id), end(id), first, last)) return {id, false};
+        }
+        int32_t id = size();
+        members.insert(members.end(), first, last);
+        offsets.push_back(members.size());
+        hashes.push_back(h);
+        if (hashes.size() * 2 > slots.size()) {
+            slots.assign(slots.size() * 2, 0);
+            for (int32_t i = 0; i < size(); ++i) place(hashes[i], i);
+        } else {
+            place(h, id);
+        }
+        return {id, true};
+    }
+};
+
+// StateSetTable split into shards by the top bits of the hash, each with
+// its own lock, so that several threads can intern at once. The id of a
+// set is its id within the shard times shards, plus the shard.
+class ShardedStateSetTable {
+public:
+    static constexpr int32_t shards = 64;
+
+private:
+    struct Shard {
+        std::mutex lock;
+        StateSetTable sets;
+    };
+    std::unique_ptr<Shard[]> parts{new Shard[shards]};
+
+public:
+    std::pair<int32_t, bool> intern(const int32_t* first, const int32_t* last) {
+        uint64_t h = StateSetTable::hash(first, last);
+        int32_t shard = h >> 58;
+        std::lock_guard<std::mutex> guard(parts[shard].lock);
+        auto interned = parts[shard].sets.intern(first, last, h);
+        return {interned.first * shards + shard, interned.second};
+    }
+
+    // The rest only while no thread is interning
+    const StateSetTable& shard(int32_t s) const { return parts[s].sets; }
+    const int32_t* begin(int32_t id) const { return parts[id % shards].sets.begin(id / shards); }
+    const int32_t* end(int32_t id) const { return parts[id % shards].sets.end(id / shards); }
+    int32_t size() const {
+        int32_t total = 0;
+        for (int32_t s = 0; s < shards; ++s) total += parts[s].sets.size();
+        return total;
+    }
+};
+
+// Epsilon closure of every NFA state. States on an epsilon cycle share one
+// closure, so closures are stored once per strongly connected component of
+// the epsilon graph, as sorted state arrays back to back.
+struct EpsilonClosures {
+    std::vector<int32_t> component_of;   // state -> component
+    std::vector<int32_t> offsets;        // component -> first member, size count + 1
+    std::vector<int32_t> members;
+
+    const int32_t* begin(int32_t state) const { return members.data() + offsets[component_of[state]]; }
+    const int32_t* end(int32_t state) const { return members.data() + offsets[component_of[state] + 1]; }
+    size_t bytes() const { return (component_of.size() + offsets.size() + members.size()) * sizeof(int32_t); }
+
+    // Tarjan numbers components so that epsilon edges only lead to equal or
+    // lower numbers; building in that order finds every successor's closure
+    // ready, and the closure of a component is its members plus those.
+    static EpsilonClosures build(const Digraph& epsilon) {
+        Components components = strongly_connected_components(epsilon);
+        EpsilonClosures closures;
+        closures.component_of.assign(components.component_of.begin(), components.component_of.end());
+        closures.offsets.push_back(0);
+
+        std::vector<int32_t> marks(epsilon.nodes(), -1);
+        for (int c = 0; c < components.count(); ++c) {
+            size_t first = closures.members.size();
+            auto add = [&](int32_t s) {
+                if (marks[s] == c) return;
+                marks[s] = c;
+                closures.members.push_back(s);
+            };
+            for (int i = components.offsets[c]; i < components.offsets[c + 1]; ++i) {
+                int m = components.members[i];
+                add(m);
+                for (int e = epsilon.offsets[m]; e < epsilon.offsets[m + 1]; ++e) {
+                    int target = components.component_of[epsilon.targets[e]];
+                    if (target == c) continue;
+                    // Index instead of pointers: members may grow while copying
+                    for (int32_t j = closures.offsets[target]; j < closures.offsets[target + 1]; ++j) {
+                        add(closures.members[j]);
+                    }
+                }
+            }
+            std::sort(closures.members.begin() + first, closures.members.end());
+            closures.offsets.push_back(closures.members.size());
+        }
+        return closures;
+    }
+};
+
+// Deterministic automaton with a dense transition table
+struct DFA {
+    int32_t states = 0;
+    int32_t start = 0;
+    std::vector<unsigned char> alphabet;    // input symbols, in column order
+    std::vector<int32_t> next;              // [state * alphabet.size() + column] -> state, -1 if none
+    std::vector<int32_t> accepting;         // state -> token kind, -1 if not accepting
+
+    // NFA states (as numbered by the caller) that make up every DFA state
+    std::vector<int32_t> set_offsets;
+    std::vector<int32_t> set_members;
+
+    int32_t columns() const { return alphabet.size(); }
+    int32_t go(int32_t state, int32_t column) const { return next[size_t(state) * alphabet.size() + column]; }
+};
+
+// Hopcroft's partition refinement, O(n·k·log n) for n states and k columns.
+//
+// Missing transitions lead to an implicit dead state, which is dropped at
+// the end together with every state equivalent to it. States start out
+// split by token kind, so accepting states only merge if they accept the
+// same token. The minimal DFA is numbered breadth first from the start
+// state, and each of its states lists the NFA states of the states merged
+// into it.
+inline DFA minimize_dfa(const DFA& dfa) {
+    if (dfa.states == 0) return dfa;
+    int32_t dead = dfa.states;
+    int32_t n = dfa.states + 1;
+    int32_t k = dfa.columns();
+    auto target = [&](int32_t s, int32_t c) {
+        int32_t t = s == dead ? -1 : dfa.go(s, c);
+        return t < 0 ? dead : t;
+    };
+    auto token = [&](int32_t s) { return s == dead ? -1 : dfa.accepting[s]; };
+
+    // Sources of the transitions into t on column c, at [c * n + t]. The
+    // offsets are as large as the transition table itself.
+    std::vector<int32_t> inverse_offsets(size_t(k) * n + 1, 0);
+    std::vector<int32_t> inverse(size_t(k) * n);
+    for (int32_t s = 0; s < n; ++s) {
+        for (int32_t c = 0; c < k; ++c) inverse_offsets[size_t(c) * n + target(s, c) + 1]++;
+    }
+    for (size_t i = 1; i < inverse_offsets.size(); ++i) inverse_offsets[i] += inverse_offsets[i - 1];
+    {
+        std::vector<int32_t> fill(inverse_offsets.begin(), inverse_offsets.end() - 1);
+        for (int32_t s = 0; s < n; ++s) {
+            for (int32_t c = 0; c < k; ++c) inverse[fill[size_t(c) * n + target(s, c)]++] = s;
+        }
+    }
+
+    // Blocks are ranges [first, last) of elements; while a splitter is
+    // processed, the marked members of a block are moved to its front
+    std::vector<int32_t> elements(n), location(n), block_of(n);
+    std::vector<int32_t> first, last, marked;
+    for (int32_t s = 0; s < n; ++s) elements[s] = s;
+    std::stable_sort(elements.begin(), elements.end(),
+                     [&](int32_t a, int32_t b) { return token(a) < token(b); });
+    for (int32_t i = 0; i < n; ++i) {
+        int32_t s = elements[i];
+        if (i == 0 || token(s) != token(elements[i - 1])) {
+            if (i > 0) last.push_back(i);
+            first.push_back(i);
+            marked.push_back(0);
+        }
+        location[s] = i;
+        block_of[s] = first.size() - 1;
+    }
+    last.push_back(n);
+
+    // Splitters (block, column). Splitting by every initial block but the
+    // largest is enough: the largest is the complement of the others.
+    std::vector<std::pair<int32_t, int32_t>> pending;
+    std::vector<char> waiting(first.size() * k, 0);
+    auto push = [&](int32_t b, int32_t c) {
+        if (waiting[size_t(b) * k + c]) return;
+        waiting[size_t(b) * k + c] = 1;
+        pending.push_back({b, c});
+    };
+    int32_t largest = 0;
+    for (int32_t b = 1; b < int32_t(first.size()); ++b) {
+        if (last[b] - first[b] > last[largest] - first[largest]) largest = b;
+    }
+    for (int32_t b = 0; b < int32_t(first.size()); ++b) {
+        if (b == largest) continue;
+        for (int32_t c = 0; c < k; ++c) push(b, c);
+    }
+
+    std::vector<int32_t> predecessors, touched;
+    while (!pending.empty()) {
+        int32_t splitter = pending.back().first;
+        int32_t c = pending.back().second;
+        pending.pop_back();
+        waiting[size_t(splitter) * k + c] = 0;
+
+        predecessors.clear();
+        for (int32_t i = first[splitter]; i < last[splitter]; ++i) {
+            size_t key = size_t(c) * n + elements[i];
+            predecessors.insert(predecessors.end(), inverse.begin() + inverse_offsets[key],
+                                inverse.begin() + inverse_offsets[key + 1]);
+        }
+        for (int32_t s : predecessors) {
+            int32_t b = block_of[s];
+            int32_t m = first[b] + marked[b];
+            if (location[s] < m) continue;
+            int32_t other = elements[m];
+            std::swap(elements[m], elements[location[s]]);
+            location[other] = location[s];
+            location[s] = m;
+            if (marked[b]++ == 0) touched.push_back(b);
+        }
+
+        // Split every touched block that is only partly marked; the smaller
+        // half becomes the new block, so a state is relabelled O(log n) times
+        for (int32_t b : touched) {
+            int32_t count = marked[b];
+            marked[b] = 0;
+            if (count == last[b] - first[b]) continue;
+            int32_t split = first[b] + count;
+            int32_t nb = first.size();
+            if (count <= last[b] - split) {
+                first.push_back(first[b]);
+                last.push_back(split);
+                first[b] = split;
+            } else {
+                first.push_back(split);
+                last.push_back(last[b]);
+                last[b] = split;
+            }
+            marked.push_back(0);
+            for (int32_t i = first[nb]; i < last[nb]; ++i) block_of[elements[i]] = nb;
+
+            // If (b, c) is still waiting both halves must be; if not, the
+            // smaller half is enough
+            waiting.resize(first.size() * k, 0);
+            for (int32_t column = 0; column < k; ++column) push(nb, column);
+        }
+        touched.clear();
+    }
+
+    // Number the blocks breadth first from the start, skipping the dead block
+    int32_t blocks = first.size();
+    std::vector<int32_t> number(blocks, -1), queue;
+    number[block_of[dfa.start]] = 0;
+    queue.push_back(block_of[dfa.start]);
+    for (size_t q = 0; q < queue.size(); ++q) {
+        int32_t representative = elements[first[queue[q]]];
+        for (int32_t c = 0; c < k; ++c) {
+            int32_t b = block_of[target(representative, c)];
+            if (b == block_of[dead] || number[b] >= 0) continue;
+            number[b] = queue.size();
+            queue.push_back(b);
+        }
+    }
+
+    DFA minimal;
+    minimal.states = queue.size();
+    minimal.alphabet = dfa.alphabet;
+    minimal.next.assign(size_t(minimal.states) * k, -1);
+    minimal.set_offsets.push_back(0);
+    for (int32_t d = 0; d < minimal.states; ++d) {
+        int32_t b = queue[d];
+        int32_t representative = elements[first[b]];
+        for (int32_t c = 0; c < k; ++c) {
+            int32_t t = block_of[target(representative, c)];
+            if (t != block_of[dead]) minimal.next[size_t(d) * k + c] = number[t];
+        }
+        minimal.accepting.push_back(token(representative));
+        for (int32_t i = first[b]; i < last[b]; ++i) {
+            int32_t s = elements[i];
+            minimal.set_members.insert(minimal.set_members.end(), dfa.set_members.begin() + dfa.set_offsets[s],
+                                       dfa.set_members.begin() + dfa.set_offsets[s + 1]);
+        }
+        auto members = minimal.set_members.begin() + minimal.set_offsets.back();
+        std::sort(members, minimal.set_members.end());
+        minimal.set_members.erase(std::unique(members, minimal.set_members.end()), minimal.set_members.end());
+        minimal.set_offsets.push_back(minimal.set_members.size());
+    }
+    return minimal;
+}
+
+// An NFA ready for subset construction: dense states, the moves of every
+// state sorted by input column, and the epsilon closure table
+struct CompiledNFA {
+    int32_t start = -1;
+    std::vector<int> names;                            // dense state -> caller's number
+    std::vector<int32_t> tokens;                       // dense state -> token kind, -1 if not final
+    std::vector<unsigned char> alphabet;               // input symbols, in column order
+    int32_t column_of[256];                            // byte -> column, -1 if not in the alphabet
+    std::vector<int32_t> move_offsets;                 // state -> first move, size states + 1
+    std::vector<std::pair<int32_t, int32_t>> moves;    // (column, target)
+    EpsilonClosures closures;
+
+    int32_t states() const { return names.size(); }
+    int32_t columns() const { return alphabet.size(); }
+
+    // Token accepted by a set of states: the smallest, so earlier rules win
+    int32_t token_of(const int32_t* first, const int32_t* last) const {
+        int32_t token = -1;
+        for (; first != last; ++first) {
+            int32_t t = tokens[*first];
+            if (t >= 0 && (token < 0 || t < token)) token = t;
+        }
+        return token;
+    }
+};
+
+// Closure and move on sets of CompiledNFA states, reusing scratch space
+// between calls. Sets are sorted and without duplicates.
+class SubsetStepper {
+    const CompiledNFA& nfa;
+    std::vector<uint32_t> marks, component_marks;   // epoch of the last visit
+    std::vector<int32_t> closed;
+    uint32_t epoch = 0;
+
+public:
+    explicit SubsetStepper(const CompiledNFA& compiled)
+        : nfa(compiled), marks(compiled.states(), 0), component_marks(compiled.closures.offsets.size() - 1, 0) {}
+
+    // Replaces the states in set by the union of their closures. Members
+    // of one component share a closure, so each component is copied once.
+    void close(std::vector<int32_t>& set) {
+        if (++epoch == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            std::fill(component_marks.begin(), component_marks.end(), 0);
+            epoch = 1;
+        }
+        closed.clear();
+        for (int32_t s : set) {
+            int32_t c = nfa.closures.component_of[s];
+            if (component_marks[c] == epoch) continue;
+            component_marks[c] = epoch;
+            const int32_t* last = nfa.closures.end(s);
+            for (const int32_t* t = nfa.closures.begin(s); t != last; ++t) {
+                if (marks[*t] == epoch) continue;
+                marks[*t] = epoch;
+                closed.push_back(*t);
+            }
+        }
+        std::sort(closed.begin(), closed.end());
+        set.swap(closed);
+    }
+
+    // Closed set of the states reached from [first, last) on column
+    void step(const int32_t* first, const int32_t* last, int32_t column, std::vector<int32_t>& out) {
+        out.clear();
+        for (; first != last; ++first) {
+            auto begin = nfa.moves.begin() + nfa.move_offsets[*first];
+            auto end = nfa.moves.begin() + nfa.move_offsets[*first + 1];
+            auto it = std::lower_bound(begin, end, std::make_pair(column, int32_t(-1)));
+            for (; it != end && it->first == column; ++it) out.push_back(it->second);
+        }
+        close(out);
+    }
+};
+
+class NFAToDFAConverter {
+private:
+    struct Edge {
+        int32_t from;
+        int32_t to;
+        int32_t symbol;   // input byte, or epsilon
+    };
+
+    static constexpr int32_t epsilon = -1;
+
+    // NFA states in the order they were first seen; states[i] is the
+    // caller's number of dense state i
+    std::vector<int> states;
+    std::unordered_map<int, int32_t> index_of;
+    std::vector<Edge> edges;
+    std::vector<int32_t> final_states;   // token kind, -1 if not final
+    int32_t start_state = -1;
+
+    int32_t dense(int state) {
+        auto inserted = index_of.emplace(state, int32_t(states.size()));
+        if (inserted.second) {
+            states.push_back(state);
+            final_states.push_back(-1);
+        }
+        return inserted.first->second;
+    }
+
+public:
+    // Add NFA transition
+    void add_transition(int from_state, char symbol, int to_state) {
+        int32_t from = dense(from_state);
+        edges.push_back({from, dense(to_state), static_cast<unsigned char>(symbol)});
+    }
+
+    // Add NFA epsilon transition
+    void add_epsilon_transition(int from_state, int to_state) {
+        int32_t from = dense(from_state);
+        edges.push_back({from, dense(to_state), epsilon});
+    }
+
+    // Set NFA start state
+    void set_start_state(int start_state_number) {
+        start_state = dense(start_state_number);
+    }
+
+    // Add NFA final state, accepting the given token kind. A DFA state
+    // with several final states accepts the smallest token, so earlier
+    // rules win as in lex.
+    void add_final_state(int final_state, int token = 0) {
+        final_states[dense(final_state)] = token;
+    }
+
+    int32_t state_count() const { return states.size(); }
+
+    // Closure table over dense NFA states
+    EpsilonClosures epsilon_closures() const {
+        std::vector<std::pair<int, int>> epsilon_edges;
+        for (const Edge& edge : edges) {
+            if (edge.symbol == epsilon) epsilon_edges.push_back({edge.from, edge.to});
+        }
+        return EpsilonClosures::build(Digraph::from_edges(states.size(), epsilon_edges));
+    }
+
+    // Dense moves and closures for subset construction
+    CompiledNFA compile() const {
+        int32_t n = states.size();
+        CompiledNFA nfa;
+        nfa.start = start_state;
+        nfa.names = states;
+        nfa.tokens = final_states;
+
+        // Alphabet columns, and the moves of every state sorted by column
+        std::fill(nfa.column_of, nfa.column_of + 256, -1);
+        bool used[256] = {};
+        for (const Edge& edge : edges) {
+            if (edge.symbol != epsilon) used[edge.symbol] = true;
+        }
+        for (int c = 0; c < 256; ++c) {
+            if (!used[c]) continue;
+            nfa.column_of[c] = nfa.alphabet.size();
+            nfa.alphabet.push_back(c);
+        }
+
+        nfa.move_offsets.assign(n + 1, 0);
+        for (const Edge& edge : edges) {
+            if (edge.symbol != epsilon) nfa.move_offsets[edge.from + 1]++;
+        }
+        for (int32_t s = 0; s < n; ++s) nfa.move_offsets[s + 1] += nfa.move_offsets[s];
+        nfa.moves.resize(nfa.move_offsets[n]);
+        std::vector<int32_t> fill(nfa.move_offsets.begin(), nfa.move_offsets.end() - 1);
+        for (const Edge& edge : edges) {
+            if (edge.symbol == epsilon) continue;
+            nfa.moves[fill[edge.from]++] = {nfa.column_of[edge.symbol], edge.to};
+        }
+        for (int32_t s = 0; s < n; ++s) {
+            std::sort(nfa.moves.begin() + nfa.move_offsets[s], nfa.moves.begin() + nfa.move_offsets[s + 1]);
+        }
+        nfa.closures = epsilon_closures();
+        return nfa;
+    }
+
+    // Subset construction without printing
+    DFA determinize() const {
+        CompiledNFA nfa = compile();
+        DFA dfa;
+        dfa.alphabet = nfa.alphabet;
+        int32_t columns = nfa.columns();
+        if (nfa.start < 0) return dfa;
+
+        SubsetStepper stepper(nfa);
+        StateSetTable sets;
+        std::vector<int32_t> scratch{nfa.start};
+        stepper.close(scratch);
+        sets.intern(scratch.data(), scratch.data() + scratch.size());
+
+        // Targets per column, filled from the members' sorted move lists
+        std::vector<std::vector<int32_t>> buckets(columns);
+        std::vector<int32_t> touched;
+        std::vector<int32_t> current;
+        for (int32_t d = 0; d < sets.size(); ++d) {
+            current.assign(sets.begin(d), sets.end(d));
+            for (int32_t s : current) {
+                for (int32_t e = nfa.move_offsets[s]; e < nfa.move_offsets[s + 1]; ++e) {
+                    std::vector<int32_t>& bucket = buckets[nfa.moves[e].first];
+                    if (bucket.empty()) touched.push_back(nfa.moves[e].first);
+                    bucket.push_back(nfa.moves[e].second);
+                }
+            }
+            std::sort(touched.begin(), touched.end());
+
+            dfa.next.resize(size_t(d + 1) * columns, -1);
+            for (int32_t column : touched) {
+                std::vector<int32_t>& bucket = buckets[column];
+                stepper.close(bucket);
+                int32_t target = sets.intern(bucket.data(), bucket.data() + bucket.size()).first;
+                dfa.next[size_t(d) * columns + column] = target;
+                bucket.clear();
+            }
+            touched.clear();
+        }
+
+        dfa.states = sets.size();
+        dfa.set_offsets.push_back(0);
+        for (int32_t d = 0; d < dfa.states; ++d) {
+            dfa.accepting.push_back(nfa.token_of(sets.begin(d), sets.end(d)));
+            for (const int32_t* s = sets.begin(d); s != sets.end(d); ++s) dfa.set_members.push_back(states[*s]);
+            std::sort(dfa.set_members.begin() + dfa.set_offsets.back(), dfa.set_members.end());
+            dfa.set_offsets.push_back(dfa.set_members.size());
+        }
+        dfa.next.resize(size_t(dfa.states) * columns, -1);
+        return dfa;
+    }
+
+    // determinize() on a thread pool. A task works through a batch of new
+    // sets, last in first out, and interns the sets it reaches in a
+    // ShardedStateSetTable; new ones join its batch, and once the batch
+    // holds more than a few dozen the older half goes back to the pool as a
+    // task of its own. Ids depend on which thread got there first, so the
+    // states are numbered breadth first at the end, which is the order
+    // determinize() finds them in: both return the same DFA.
+    DFA determinize(ThreadPool& pool) const {
+        if (pool.size() <= 1) return determinize();
+        CompiledNFA nfa = compile();
+        DFA dfa;
+        dfa.alphabet = nfa.alphabet;
+        int32_t columns = nfa.columns();
+        if (nfa.start < 0) return dfa;
+
+        // Sets waiting to be expanded, with their members
+        struct Batch {
+            std::vector<int32_t> ids, offsets{0}, members;
+            void push(int32_t id, const int32_t* first, const int32_t* last) {
+                ids.push_back(id);
+                members.insert(members.end(), first, last);
+                offsets.push_back(members.size());
+            }
+        };
+        // Scratch space and finished rows of one running task
+        struct Worker {
+            SubsetStepper stepper;
+            std::vector<std::vector<int32_t>> buckets;
+            std::vector<int32_t> touched, current;
+            std::vector<int32_t> done, rows;   // set ids, and a row of targets for each
+            Worker(const CompiledNFA& nfa) : stepper(nfa), buckets(nfa.columns()) {}
+        };
+        const size_t split_at = 64;
+
+        ShardedStateSetTable sets;
+        std::mutex workers_lock;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<Worker*> idle;
+
+        std::function<void(Batch&)> run = [&](Batch& batch) {
+            Worker* w;
+            {
+                std::lock_guard<std::mutex> guard(workers_lock);
+                if (idle.empty()) {
+                    workers.emplace_back(new Worker(nfa));
+                    idle.push_back(workers.back().get());
+                }
+                w = idle.back();
+                idle.pop_back();
+            }
+            while (!batch.ids.empty()) {
+                if (batch.ids.size() > split_at) {
+                    size_t half = batch.ids.size() / 2;
+                    auto rest = std::make_shared<Batch>();
+                    for (size_t i = 0; i < half; ++i) {
+                        rest->push(batch.ids[i], batch.members.data() + batch.offsets[i],
+                                   batch.members.data() + batch.offsets[i + 1]);
+                    }
+                    int32_t moved = batch.offsets[half];
+                    batch.ids.erase(batch.ids.begin(), batch.ids.begin() + half);
+                    batch.members.erase(batch.members.begin(), batch.members.begin() + moved);
+                    batch.offsets.erase(batch.offsets.begin(), batch.offsets.begin() + half);
+                    for (int32_t& offset : batch.offsets) offset -= moved;
+                    pool.submit([&run, rest] { run(*rest); });
+                }
+
+                int32_t d = batch.ids.back();
+                w->current.assign(batch.members.begin() + batch.offsets[batch.ids.size() - 1], batch.members.end());
+                batch.ids.pop_back();
+                batch.offsets.pop_back();
+                batch.members.resize(batch.offsets.back());
+
+                for (int32_t s : w->current) {
+                    for (int32_t e = nfa.move_offsets[s]; e < nfa.move_offsets[s + 1]; ++e) {
+                        std::vector<int32_t>& bucket = w->buckets[nfa.moves[e].first];
+                        if (bucket.empty()) w->touched.push_back(nfa.moves[e].first);
+                        bucket.push_back(nfa.moves[e].second);
+                    }
+                }
+                w->done.push_back(d);
+                w->rows.resize(w->rows.size() + columns, -1);
+                int32_t* row = w->rows.data() + w->rows.size() - columns;
+                for (int32_t column : w->touched) {
+                    std::vector<int32_t>& bucket = w->buckets[column];
+                    w->stepper.close(bucket);
+                    auto interned = sets.intern(bucket.data(), bucket.data() + bucket.size());
+                    row[column] = interned.first;
+                    if (interned.second) batch.push(interned.first, bucket.data(), bucket.data() + bucket.size());
+                    bucket.clear();
+                }
+                w->touched.clear();
+            }
+            std::lock_guard<std::mutex> guard(workers_lock);
+            idle.push_back(w);
+        };
+
+        auto first = std::make_shared<Batch>();
+        std::vector<int32_t> scratch{nfa.start};
+        SubsetStepper(nfa).close(scratch);
+        int32_t start = sets.intern(scratch.data(), scratch.data() + scratch.size()).first;
+        first->push(start, scratch.data(), scratch.data() + scratch.size());
+        pool.submit([&run, first] { run(*first); });
+        pool.wait();
+
+        // Sharded ids to dense indexes, and the rows by dense index
+        int32_t total = sets.size();
+        std::vector<int32_t> base(ShardedStateSetTable::shards + 1, 0);
+        for (int32_t s = 0; s < ShardedStateSetTable::shards; ++s) base[s + 1] = base[s] + sets.shard(s).size();
+        auto dense = [&](int32_t id) { return base[id % ShardedStateSetTable::shards] + id / ShardedStateSetTable::shards; };
+        std::vector<const int32_t*> row_of(total);
+        for (const auto& w : workers) {
+            for (size_t i = 0; i < w->done.size(); ++i) row_of[dense(w->done[i])] = w->rows.data() + i * columns;
+        }
+
+        // Breadth first from the start, columns in order
+        std::vector<int32_t> number(total, -1), order{start};
+        number[dense(start)] = 0;
+        dfa.next.assign(size_t(total) * columns, -1);
+        for (size_t q = 0; q < order.size(); ++q) {
+            const int32_t* row = row_of[dense(order[q])];
+            for (int32_t column = 0; column < columns; ++column) {
+                if (row[column] < 0) continue;
+                int32_t& target = number[dense(row[column])];
+                if (target < 0) {
+                    target = order.size();
+                    order.push_back(row[column]);
+                }
+                dfa.next[q * columns + column] = target;
+            }
+        }
+
+        dfa.states = total;
+        dfa.set_offsets.push_back(0);
+        for (int32_t id : order) {
+            dfa.accepting.push_back(nfa.token_of(sets.begin(id), sets.end(id)));
+            for (const int32_t* s = sets.begin(id); s != sets.end(id); ++s) dfa.set_members.push_back(states[*s]);
+            std::sort(dfa.set_members.begin() + dfa.set_offsets.back(), dfa.set_members.end());
+            dfa.set_offsets.push_back(dfa.set_members.size());
+        }
+        return dfa;
+    }
+
+    // Convert NFA to DFA
+    DFA convert_to_dfa() {
+        DFA dfa = determinize();
+
+        // Print DFA details
+        print_dfa_details(dfa);
+
+        DFA minimal = minimize_dfa(dfa);
+        std::cout << "\nMinimized DFA: " << dfa.states << " states -> " << minimal.states << " states\n";
+        print_dfa_details(minimal);
+
+        return minimal;
+    }
+
+    // Print DFA details
+    void print_dfa_details(const DFA& dfa) const {
+        std::cout << "\nDFA State Mapping:\n";
+        for (int32_t d = 0; d < dfa.states; ++d) {
+            std::cout << "DFA State " << d << " = {";
+            for (int32_t i = dfa.set_offsets[d]; i < dfa.set_offsets[d + 1]; ++i) {
+                std::cout << dfa.set_members[i] << " ";
+            }
+            std::cout << "}\n";
+        }
+
+        std::cout << "\nDFA Transitions:\n";
+        for (int32_t d = 0; d < dfa.states; ++d) {
+            for (int32_t column = 0; column < dfa.columns(); ++column) {
+                int32_t target = dfa.go(d, column);
+                if (target < 0) continue;
+                std::cout << "δ(q" << d << ", " << dfa.alphabet[column] << ") = q" << target << std::endl;
+            }
+        }
+
+        std::cout << "\nDFA Accepting States:\n";
+        for (int32_t d = 0; d < dfa.states; ++d) {
+            if (dfa.accepting[d] >= 0) std::cout << "q" << d << " (token " << dfa.accepting[d] << ")\n";
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,412 @@
+// Benchmark and cross-check for subset construction in nfa.h.
+//
+// A seeded generator builds a tokenizer-like NFA: the union of many random
+// rules (keywords, and sequences of character classes with *, + and ?),
+// each built by Thompson's construction. The NFA is determinized with
+// NFAToDFAConverter and with the original std::map/std::set algorithm,
+// and the two DFAs are compared state by state. Every rule is its own
+// token kind, or one of --tokens N kinds. The parallel determinize() runs
+// on --jobs threads and must return exactly the sequential DFA. The DFA is
+// then minimized, and the result is checked against Moore's algorithm and
+// for equivalence with the unminimized DFA. Last, --text-kb of random
+// text is tokenized with the DenseDFA and with the engine AutoMatcher
+// picks, which for small NFAs simulates them bit-parallel without subset
+// construction; setup includes determinizing where it is needed.
+//
+//   g++ -std=c++17 -O2 -pthread -o nfa_bench nfa_bench.cpp
+//   ./nfa_bench --rules 300 --length 8 --alphabet 40 --seed 3 --jobs 4
+//   ./nfa_bench --rules 10 --length 5 --no-legacy
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <set>
+#include <queue>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include "dfa.h"
+
+using namespace std;
+
+struct GeneratorOptions {
+    int rules = 300;
+    int length = 8;            // maximum atoms per rule
+    int alphabet = 40;         // distinct input characters
+    int class_size = 6;        // maximum characters per class
+    double keywords = 0.3;     // chance that a rule is a plain keyword
+    double repeat = 0.3;       // chance that an atom gets *, + or ?
+    int tokens = 0;            // token kinds, rule r accepts r % tokens; 0 for one per rule
+    unsigned seed = 1;
+};
+
+struct Edge {
+    int from;
+    int symbol;   // input character, or epsilon
+    int to;
+};
+
+const int epsilon = -1;
+
+struct GeneratedNFA {
+    int states = 0;
+    int start = 0;
+    vector<Edge> edges;
+    vector<int> finals;
+};
+
+// Thompson's construction over an edge list
+struct Fragment {
+    int start, end;
+};
+
+class Thompson {
+    GeneratedNFA& nfa;
+
+public:
+    explicit Thompson(GeneratedNFA& target) : nfa(target) {}
+
+    int state() { return nfa.states++; }
+    void edge(int from, int symbol, int to) { nfa.edges.push_back({from, symbol, to}); }
+
+    Fragment chars(const vector<char>& symbols) {
+        Fragment f{state(), state()};
+        for (char c : symbols) edge(f.start, c, f.end);
+        return f;
+    }
+    Fragment concat(Fragment a, Fragment b) {
+        edge(a.end, epsilon, b.start);
+        return {a.start, b.end};
+    }
+    Fragment star(Fragment a) {
+        Fragment f{state(), state()};
+        edge(f.start, epsilon, a.start);
+        edge(f.start, epsilon, f.end);
+        edge(a.end, epsilon, a.start);
+        edge(a.end, epsilon, f.end);
+        return f;
+    }
+    Fragment plus(Fragment a) {
+        edge(a.end, epsilon, a.start);
+        return a;
+    }
+    Fragment optional(Fragment a) {
+        edge(a.start, epsilon, a.end);
+        return a;
+    }
+};
+
+GeneratedNFA generate_nfa(const GeneratorOptions& options) {
+    mt19937 rng(options.seed);
+    uniform_real_distribution<double> chance(0.0, 1.0);
+    auto character = [&]() { return char('!' + rng() % max(1, min(options.alphabet, 94))); };
+
+    GeneratedNFA nfa;
+    Thompson build(nfa);
+    nfa.start = build.state();
+    for (int r = 0; r < options.rules; ++r) {
+        bool keyword = chance(rng) < options.keywords;
+        int atoms = 1 + rng() % max(1, options.length);
+        Fragment rule{-1, -1};
+        for (int a = 0; a < atoms; ++a) {
+            vector<char> symbols(keyword ? 1 : 1 + rng() % max(1, options.class_size));
+            for (char& c : symbols) c = character();
+            Fragment atom = build.chars(symbols);
+            // Stacked operators such as (a?)+ give epsilon cycles
+            for (int stacked = 0; !keyword && stacked < 2 && chance(rng) < options.repeat; ++stacked) {
+                int kind = rng() % 3;
+                atom = kind == 0 ? build.star(atom) : kind == 1 ? build.plus(atom) : build.optional(atom);
+            }
+            rule = rule.start < 0 ? atom : build.concat(rule, atom);
+        }
+        build.edge(nfa.start, epsilon, rule.start);
+        nfa.finals.push_back(rule.end);
+    }
+    return nfa;
+}
+
+// The original subset construction: std::set closures, std::map states
+struct LegacyDFA {
+    map<set<int>, int> states;
+    map<pair<int, int>, int> transitions;
+};
+
+LegacyDFA legacy_convert(const GeneratedNFA& nfa) {
+    map<pair<int, int>, set<int>> nfa_transitions;
+    set<int> alphabet;
+    for (const Edge& e : nfa.edges) {
+        nfa_transitions[{e.from, e.symbol}].insert(e.to);
+        if (e.symbol != epsilon) alphabet.insert(e.symbol);
+    }
+
+    auto closure_of = [&](int state) {
+        set<int> closure;
+        vector<int> stack = {state};
+        while (!stack.empty()) {
+            int current = stack.back();
+            stack.pop_back();
+            if (closure.count(current)) continue;
+            closure.insert(current);
+            auto it = nfa_transitions.find({current, epsilon});
+            if (it != nfa_transitions.end()) {
+                for (int next : it->second) {
+                    if (!closure.count(next)) stack.push_back(next);
+                }
+            }
+        }
+        return closure;
+    };
+    auto closure_of_set = [&](const set<int>& states) {
+        set<int> closure;
+        for (int s : states) {
+            set<int> c = closure_of(s);
+            closure.insert(c.begin(), c.end());
+        }
+        return closure;
+    };
+    auto move = [&](const set<int>& states, int symbol) {
+        set<int> moved;
+        for (int s : states) {
+            auto it = nfa_transitions.find({s, symbol});
+            if (it != nfa_transitions.end()) moved.insert(it->second.begin(), it->second.end());
+        }
+        return moved;
+    };
+
+    LegacyDFA dfa;
+    queue<set<int>> unmarked;
+    set<int> start = closure_of(nfa.start);
+    dfa.states[start] = 0;
+    unmarked.push(start);
+    while (!unmarked.empty()) {
+        set<int> current = unmarked.front();
+        unmarked.pop();
+        int id = dfa.states[current];
+        for (int symbol : alphabet) {
+            set<int> next = closure_of_set(move(current, symbol));
+            if (next.empty()) continue;
+            auto inserted = dfa.states.emplace(next, int(dfa.states.size()));
+            if (inserted.second) unmarked.push(next);
+            dfa.transitions[{id, symbol}] = inserted.first->second;
+        }
+    }
+    return dfa;
+}
+
+// Transitions that differ between the two DFAs, matching states by their NFA sets
+size_t count_differences(const DFA& dfa, const LegacyDFA& legacy) {
+    map<vector<int>, int> id_of;
+    for (int32_t d = 0; d < dfa.states; ++d) {
+        id_of[vector<int>(dfa.set_members.begin() + dfa.set_offsets[d],
+                          dfa.set_members.begin() + dfa.set_offsets[d + 1])] = d;
+    }
+    vector<int> ours(legacy.states.size(), -1);
+    size_t differences = 0;
+    for (const auto& state : legacy.states) {
+        auto it = id_of.find(vector<int>(state.first.begin(), state.first.end()));
+        if (it == id_of.end()) differences++;
+        else ours[state.second] = it->second;
+    }
+
+    size_t transitions = 0;
+    for (int32_t d = 0; d < dfa.states; ++d) {
+        for (int32_t column = 0; column < dfa.columns(); ++column) transitions += dfa.go(d, column) >= 0;
+    }
+    for (const auto& t : legacy.transitions) {
+        int from = ours[t.first.first], to = ours[t.second];
+        auto column = lower_bound(dfa.alphabet.begin(), dfa.alphabet.end(), (unsigned char)t.first.second);
+        if (from < 0 || to < 0 || column == dfa.alphabet.end() ||
+            dfa.go(from, column - dfa.alphabet.begin()) != to) {
+            differences++;
+        }
+    }
+    return differences + (transitions > legacy.transitions.size() ? transitions - legacy.transitions.size() : 0);
+}
+
+// Number of live states of the minimal DFA, by Moore's round-based
+// refinement with a dead state for missing transitions
+int32_t moore_states(const DFA& dfa) {
+    int32_t n = dfa.states + 1, dead = dfa.states, k = dfa.columns();
+    vector<int32_t> cls(n);
+    for (int32_t s = 0; s < n; ++s) cls[s] = s == dead ? -1 : dfa.accepting[s];
+    for (size_t classes = 0;;) {
+        map<vector<int32_t>, int32_t> signatures;
+        vector<int32_t> next(n);
+        for (int32_t s = 0; s < n; ++s) {
+            vector<int32_t> signature{cls[s]};
+            for (int32_t c = 0; c < k; ++c) {
+                int32_t t = s == dead ? -1 : dfa.go(s, c);
+                signature.push_back(cls[t < 0 ? dead : t]);
+            }
+            next[s] = signatures.emplace(signature, int32_t(signatures.size())).first->second;
+        }
+        cls.swap(next);
+        if (signatures.size() == classes) break;
+        classes = signatures.size();
+    }
+    // Subset construction only makes reachable states
+    set<int32_t> live;
+    for (int32_t s = 0; s < dfa.states; ++s) {
+        if (cls[s] != cls[dead]) live.insert(cls[s]);
+    }
+    return live.size();
+}
+
+// True if both DFAs accept the same tokens on every input: a walk over
+// pairs of states, with -1 standing for the dead state on either side
+bool equivalent(const DFA& a, const DFA& b) {
+    if (a.alphabet != b.alphabet) return false;
+    set<pair<int32_t, int32_t>> seen{{a.start, b.start}};
+    vector<pair<int32_t, int32_t>> stack{{a.start, b.start}};
+    while (!stack.empty()) {
+        pair<int32_t, int32_t> p = stack.back();
+        stack.pop_back();
+        int32_t token_a = p.first < 0 ? -1 : a.accepting[p.first];
+        int32_t token_b = p.second < 0 ? -1 : b.accepting[p.second];
+        if (token_a != token_b) return false;
+        for (int32_t c = 0; c < a.columns(); ++c) {
+            pair<int32_t, int32_t> q{p.first < 0 ? -1 : a.go(p.first, c), p.second < 0 ? -1 : b.go(p.second, c)};
+            if (q.first < 0 && q.second < 0) continue;
+            if (seen.insert(q).second) stack.push_back(q);
+        }
+    }
+    return true;
+}
+
+bool same_dfa(const DFA& a, const DFA& b) {
+    return a.states == b.states && a.alphabet == b.alphabet && a.next == b.next && a.accepting == b.accepting &&
+           a.set_offsets == b.set_offsets && a.set_members == b.set_members;
+}
+
+template <class F>
+double best_ms(int runs, F run) {
+    double best = 0;
+    for (int r = 0; r < runs; ++r) {
+        auto start = chrono::steady_clock::now();
+        run();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (r == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    GeneratorOptions options;
+    int runs = 3;
+    unsigned jobs = 0;   // 0: one per hardware thread
+    size_t text_kb = 1024;
+    bool legacy = true;
+
+    for (int i = 1; i < argc; ++i) {
+        string flag = argv[i];
+        if (flag == "--no-legacy") {
+            legacy = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cout << "Missing value for " << flag << "\n";
+            return 1;
+        }
+        string value = argv[++i];
+        if (flag == "--rules") options.rules = stoi(value);
+        else if (flag == "--length") options.length = stoi(value);
+        else if (flag == "--alphabet") options.alphabet = stoi(value);
+        else if (flag == "--class-size") options.class_size = stoi(value);
+        else if (flag == "--keywords") options.keywords = stod(value);
+        else if (flag == "--repeat") options.repeat = stod(value);
+        else if (flag == "--tokens") options.tokens = stoi(value);
+        else if (flag == "--seed") options.seed = stoul(value);
+        else if (flag == "--runs") runs = max(1, stoi(value));
+        else if (flag == "--jobs") jobs = max(0, stoi(value));
+        else if (flag == "--text-kb") text_kb = stoul(value);
+        else {
+            cout << "Unknown option: " << flag << "\n";
+            return 1;
+        }
+    }
+
+    GeneratedNFA nfa = generate_nfa(options);
+    cout << "NFA: " << nfa.states << " states, " << nfa.edges.size() << " transitions, "
+         << options.rules << " rules, seed " << options.seed << "\n\n";
+
+    NFAToDFAConverter converter;
+    for (const Edge& e : nfa.edges) {
+        if (e.symbol == epsilon) converter.add_epsilon_transition(e.from, e.to);
+        else converter.add_transition(e.from, char(e.symbol), e.to);
+    }
+    converter.set_start_state(nfa.start);
+    for (size_t r = 0; r < nfa.finals.size(); ++r) converter.add_final_state(nfa.finals[r], options.tokens > 0 ? r % options.tokens : r);
+
+    EpsilonClosures closures = converter.epsilon_closures();
+    cout << "Epsilon closures: " << closures.offsets.size() - 1 << " components, "
+         << closures.members.size() << " members, " << closures.bytes() << " bytes\n\n";
+
+    cout << left << setw(28) << "implementation" << right << setw(12) << "best ms"
+         << setw(12) << "DFA states" << "  check\n";
+
+    DFA dfa;
+    double ms = best_ms(runs, [&] { dfa = converter.determinize(); });
+    cout << left << setw(28) << "nfa.h determinize" << right << setw(12) << fixed << setprecision(3) << ms
+         << setw(12) << dfa.states << "\n";
+
+    bool parallel_ok;
+    {
+        // At least two workers, so the parallel path runs even on one core
+        ThreadPool pool(max(2u, jobs ? jobs : thread::hardware_concurrency()));
+        DFA parallel;
+        double parallel_ms = best_ms(runs, [&] { parallel = converter.determinize(pool); });
+        parallel_ok = same_dfa(dfa, parallel);
+        cout << left << setw(28) << "nfa.h determinize -j" + to_string(pool.size()) << right << setw(12)
+             << parallel_ms << setw(12) << parallel.states << "  " << (parallel_ok ? "ok" : "MISMATCH")
+             << "\n";
+    }
+
+    DFA minimal;
+    double minimize_ms = best_ms(runs, [&] { minimal = minimize_dfa(dfa); });
+    bool minimal_ok = equivalent(dfa, minimal) && moore_states(dfa) == minimal.states;
+    cout << left << setw(28) << "nfa.h minimize_dfa" << right << setw(12) << minimize_ms
+         << setw(12) << minimal.states << "  " << (minimal_ok ? "ok" : "MISMATCH") << "\n";
+
+    bool legacy_ok = true;
+    if (legacy) {
+        LegacyDFA reference;
+        double legacy_ms = best_ms(1, [&] { reference = legacy_convert(nfa); });
+        size_t differences = count_differences(dfa, reference);
+        legacy_ok = differences == 0;
+        cout << left << setw(28) << "std::map/std::set original" << right << setw(12) << legacy_ms
+             << setw(12) << reference.states.size() << "  "
+             << (differences == 0 ? string("ok") : "MISMATCH in " + to_string(differences) + " entries") << "\n"
+             << "\nSpeedup: " << setprecision(1) << legacy_ms / ms << "x\n";
+    }
+
+    // Random text over the rules' characters
+    mt19937 rng(options.seed);
+    string text(text_kb << 10, ' ');
+    for (char& c : text) c = char('!' + rng() % max(1, min(options.alphabet, 94)));
+    auto tokens_of = [&](const auto& engine, double& seconds) {
+        vector<pair<int32_t, size_t>> tokens;
+        auto start = chrono::steady_clock::now();
+        engine.tokenize(text.data(), text.size(), [&](int32_t token, size_t, size_t length) {
+            tokens.push_back({token, length});
+        });
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return tokens;
+    };
+    double mb = double(text.size()) / (1 << 20), seconds;
+    cout << "\n" << left << setw(32) << "matcher" << right << setw(12) << "setup ms" << setw(12) << "MB/s"
+         << "  check\n";
+    DenseDFA table(minimal);
+    double table_ms = best_ms(runs, [&] { table = DenseDFA(minimal); });
+    auto reference = tokens_of(table, seconds);
+    cout << left << setw(32) << "determinize + DenseDFA" << right << setw(12) << ms + minimize_ms + table_ms
+         << setw(12) << mb / seconds << "\n";
+
+    unique_ptr<AutoMatcher> automatic;
+    double auto_ms = best_ms(runs, [&] { automatic.reset(new AutoMatcher(converter)); });
+    bool same = tokens_of(*automatic, seconds) == reference;
+    cout << left << setw(32) << string("AutoMatcher: ") + automatic->engine_name() << right << setw(12) << auto_ms
+         << setw(12) << mb / seconds << "  " << (same ? "ok" : "MISMATCH") << "\n";
+    return same && parallel_ok && minimal_ok && legacy_ok ? 0 : 1;
+}
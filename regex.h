@@ -0,0 +1,371 @@
+#ifndef REGEX_H
+#define REGEX_H
+
+#include <bitset>
+#include <cctype>
+#include <map>
+#include <string>
+#include <vector>
+#include "nfa.h"
+
+// Regular expressions in flex syntax, compiled into an NFA by Thompson's
+// construction.
+//
+// Supported: literal bytes; escapes \n \t \r \f \v \a \b, octal \ooo, hex
+// \xhh and \c for any other c; "quoted strings"; . (any byte but newline);
+// [classes] with ranges and ^ negation; grouping; |, *, +, ?, {n}, {n,}
+// and {n,m}; and {NAME} for a definition, which behaves as a group.
+// Anchors, trailing context and start conditions are rejected.
+
+// Length of the pattern at the start of a rule line: it ends at the first
+// whitespace outside quotes and brackets
+inline size_t regex_pattern_length(const std::string& line) {
+    bool quoted = false;
+    int bracket = 0;   // 0 outside a class, else characters seen inside it
+    size_t i = 0;
+    for (; i < line.size(); ++i) {
+        char c = line[i];
+        if (c == '\\' && i + 1 < line.size()) {
+            ++i;
+            if (bracket) bracket++;
+            continue;
+        }
+        if (bracket) {
+            // ] right after [ or [^ is a literal
+            bool literal = bracket == 1 || (bracket == 2 && line[i - 1] == '^');
+            bracket = c == ']' && !literal ? 0 : bracket + 1;
+        } else if (quoted) {
+            quoted = c != '"';
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == '[') {
+            bracket = 1;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            break;
+        }
+    }
+    return i;
+}
+
+class RegexCompiler {
+    // Parse tree; children are indexes into nodes
+    struct Node {
+        enum Kind { SET, EMPTY, CONCAT, ALTERNATIVE, REPEAT } kind;
+        std::bitset<256> bytes;        // SET
+        std::vector<int> children;     // CONCAT, ALTERNATIVE; REPEAT has one
+        int min = 0, max = 0;          // REPEAT, max -1 for no limit
+    };
+
+    struct Fragment {
+        int start, end;
+    };
+
+    NFAToDFAConverter& nfa;
+    std::map<std::string, std::string> definitions;
+    std::vector<Node> nodes;
+    int next_state = 1;   // state 0 is the start of every rule
+
+    // Parser state for the pattern being read
+    const std::string* text = nullptr;
+    size_t pos = 0;
+    int depth = 0;
+    std::string failure;
+
+    int add(Node node) {
+        nodes.push_back(std::move(node));
+        return nodes.size() - 1;
+    }
+    bool fail(const std::string& message) {
+        if (failure.empty()) failure = message;
+        return false;
+    }
+    int invalid(const std::string& message) {
+        fail(message);
+        return -1;
+    }
+    bool at_end() const { return pos >= text->size(); }
+    char peek() const { return (*text)[pos]; }
+
+    // Byte after a backslash
+    int escape() {
+        if (at_end()) return invalid("trailing backslash");
+        char c = (*text)[pos++];
+        switch (c) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case 'a': return '\a';
+        case 'b': return '\b';
+        case 'x': {
+            int value = 0, digits = 0;
+            while (digits < 2 && !at_end() && std::isxdigit(static_cast<unsigned char>(peek()))) {
+                char h = (*text)[pos++];
+                value = value * 16 + (std::isdigit(static_cast<unsigned char>(h)) ? h - '0' : std::tolower(h) - 'a' + 10);
+                digits++;
+            }
+            return digits ? value : invalid("\\x without hex digits");
+        }
+        default:
+            if (c >= '0' && c <= '7') {
+                int value = c - '0';
+                for (int digits = 1; digits < 3 && !at_end() && peek() >= '0' && peek() <= '7'; ++digits) {
+                    value = value * 8 + ((*text)[pos++] - '0');
+                }
+                return value & 0xff;
+            }
+            return static_cast<unsigned char>(c);
+        }
+    }
+
+    int parse_class() {
+        Node node{Node::SET, {}, {}};
+        bool negate = !at_end() && peek() == '^';
+        if (negate) pos++;
+        bool first = true;
+        for (;; first = false) {
+            if (at_end()) return invalid("unterminated character class");
+            if (peek() == ']' && !first) break;
+            int low = peek() == '\\' ? (pos++, escape()) : static_cast<unsigned char>((*text)[pos++]);
+            if (low < 0) return -1;
+            int high = low;
+            if (pos + 1 < text->size() && peek() == '-' && (*text)[pos + 1] != ']') {
+                pos++;
+                high = peek() == '\\' ? (pos++, escape()) : static_cast<unsigned char>((*text)[pos++]);
+                if (high < 0) return -1;
+                if (high < low) return invalid("reversed range in character class");
+            }
+            for (int c = low; c <= high; ++c) node.bytes.set(c);
+        }
+        pos++;
+        if (negate) node.bytes.flip();
+        return add(node);
+    }
+
+    int literal(int c) {
+        Node node{Node::SET, {}, {}};
+        node.bytes.set(c);
+        return add(node);
+    }
+
+    int parse_atom() {
+        char c = (*text)[pos++];
+        switch (c) {
+        case '(': {
+            int inner = parse_alternative();
+            if (inner < 0) return -1;
+            if (at_end() || peek() != ')') return invalid("missing )");
+            pos++;
+            return inner;
+        }
+        case '[':
+            return parse_class();
+        case '"': {
+            Node sequence{Node::CONCAT, {}, {}};
+            while (!at_end() && peek() != '"') {
+                int b = peek() == '\\' ? (pos++, escape()) : static_cast<unsigned char>((*text)[pos++]);
+                if (b < 0) return -1;
+                sequence.children.push_back(literal(b));
+            }
+            if (at_end()) return invalid("unterminated string");
+            pos++;
+            return sequence.children.empty() ? add({Node::EMPTY, {}, {}}) : add(sequence);
+        }
+        case '.': {
+            Node node{Node::SET, {}, {}};
+            node.bytes.set();
+            node.bytes.reset('\n');
+            return add(node);
+        }
+        case '{': {
+            size_t close = text->find('}', pos);
+            if (close == std::string::npos) return invalid("missing }");
+            std::string name = text->substr(pos, close - pos);
+            pos = close + 1;
+            auto it = definitions.find(name);
+            if (it == definitions.end()) return invalid("undefined definition {" + name + "}");
+            if (depth > 32) return invalid("definitions nest too deeply at {" + name + "}");
+            const std::string* outer = text;
+            size_t outer_pos = pos;
+            text = &it->second;
+            pos = 0;
+            depth++;
+            int inner = parse_alternative();
+            if (inner >= 0 && !at_end()) inner = invalid("unexpected " + std::string(1, peek()) + " in {" + name + "}");
+            depth--;
+            text = outer;
+            pos = outer_pos;
+            return inner;
+        }
+        case '\\': {
+            int b = escape();
+            return b < 0 ? -1 : literal(b);
+        }
+        case '^':
+        case '$':
+        case '/':
+        case '<':
+            return invalid(std::string("unsupported operator ") + c);
+        case ')':
+        case '|':
+        case '*':
+        case '+':
+        case '?':
+            return invalid(std::string("unexpected ") + c);
+        default:
+            return literal(static_cast<unsigned char>(c));
+        }
+    }
+
+    // {n}, {n,} or {n,m} after an atom; false if the brace is not a count
+    bool parse_count(int& min, int& max) {
+        size_t p = pos + 1;
+        auto number = [&](int& value) {
+            size_t first = p;
+            value = 0;
+            while (p < text->size() && std::isdigit(static_cast<unsigned char>((*text)[p]))) {
+                value = value * 10 + ((*text)[p++] - '0');
+                if (value > 1000) return false;
+            }
+            return p > first;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (p < text->size() && (*text)[p] == ',') {
+            p++;
+            if (p < text->size() && (*text)[p] == '}') max = -1;
+            else if (!number(max)) return false;
+        }
+        if (p >= text->size() || (*text)[p] != '}') return false;
+        pos = p + 1;
+        return true;
+    }
+
+    int parse_repeat() {
+        int atom = parse_atom();
+        while (atom >= 0 && !at_end()) {
+            Node node{Node::REPEAT, {}, {atom}};
+            char c = peek();
+            if (c == '*') node.min = 0, node.max = -1, pos++;
+            else if (c == '+') node.min = 1, node.max = -1, pos++;
+            else if (c == '?') node.min = 0, node.max = 1, pos++;
+            else if (c != '{' || !parse_count(node.min, node.max)) break;
+            if (node.max >= 0 && node.max < node.min) return invalid("bad repeat count");
+            atom = add(node);
+        }
+        return atom;
+    }
+
+    int parse_concat() {
+        Node node{Node::CONCAT, {}, {}};
+        while (!at_end() && peek() != '|' && peek() != ')') {
+            int child = parse_repeat();
+            if (child < 0) return -1;
+            node.children.push_back(child);
+        }
+        if (node.children.empty()) return add({Node::EMPTY, {}, {}});
+        return node.children.size() == 1 ? node.children[0] : add(node);
+    }
+
+    int parse_alternative() {
+        Node node{Node::ALTERNATIVE, {}, {}};
+        for (;;) {
+            int child = parse_concat();
+            if (child < 0) return -1;
+            node.children.push_back(child);
+            if (at_end() || peek() != '|') break;
+            pos++;
+        }
+        return node.children.size() == 1 ? node.children[0] : add(node);
+    }
+
+    // Thompson's construction, one fragment per node
+    Fragment build(int index) {
+        const Node& node = nodes[index];
+        Fragment f{next_state++, next_state++};
+        switch (node.kind) {
+        case Node::SET:
+            for (int c = 0; c < 256; ++c) {
+                if (node.bytes.test(c)) nfa.add_transition(f.start, static_cast<char>(c), f.end);
+            }
+            break;
+        case Node::EMPTY:
+            nfa.add_epsilon_transition(f.start, f.end);
+            break;
+        case Node::CONCAT: {
+            int at = f.start;
+            for (int child : node.children) {
+                Fragment c = build(child);
+                nfa.add_epsilon_transition(at, c.start);
+                at = c.end;
+            }
+            nfa.add_epsilon_transition(at, f.end);
+            break;
+        }
+        case Node::ALTERNATIVE:
+            for (int child : node.children) {
+                Fragment c = build(child);
+                nfa.add_epsilon_transition(f.start, c.start);
+                nfa.add_epsilon_transition(c.end, f.end);
+            }
+            break;
+        case Node::REPEAT: {
+            // min copies in a row, then a loop or max - min optional copies
+            int at = f.start;
+            int child = node.children[0];
+            for (int i = 0; i < node.min; ++i) {
+                Fragment c = build(child);
+                nfa.add_epsilon_transition(at, c.start);
+                at = c.end;
+            }
+            if (node.max < 0) {
+                Fragment c = build(child);
+                nfa.add_epsilon_transition(at, c.start);
+                nfa.add_epsilon_transition(c.end, at);
+                nfa.add_epsilon_transition(at, f.end);
+            } else {
+                for (int i = node.min; i < node.max; ++i) {
+                    Fragment c = build(child);
+                    nfa.add_epsilon_transition(at, c.start);
+                    nfa.add_epsilon_transition(at, f.end);
+                    at = c.end;
+                }
+                nfa.add_epsilon_transition(at, f.end);
+            }
+            break;
+        }
+        }
+        return f;
+    }
+
+public:
+    explicit RegexCompiler(NFAToDFAConverter& target) : nfa(target) { nfa.set_start_state(0); }
+
+    // Message for the last pattern that failed
+    const std::string& error() const { return failure; }
+
+    // NAME pattern, for {NAME} in later patterns
+    void define(const std::string& name, const std::string& pattern) { definitions[name] = pattern; }
+
+    // Adds a rule that accepts token; rules with smaller tokens win ties
+    bool add_rule(const std::string& pattern, int token) {
+        failure.clear();
+        nodes.clear();
+        text = &pattern;
+        pos = 0;
+        depth = 0;
+        if (pattern.empty()) return fail("empty pattern");
+        int root = parse_alternative();
+        if (root >= 0 && !at_end()) root = invalid("unexpected " + std::string(1, peek()));
+        text = nullptr;
+        if (root < 0) return false;
+
+        Fragment f = build(root);
+        nfa.add_epsilon_transition(0, f.start);
+        nfa.add_final_state(f.end, token);
+        return true;
+    }
+};
+
+#endif
@@ -1,99 +1,275 @@
 #include <iostream>
-#include <map>
-#include <set>
+#include <fstream>
+#include <sstream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <chrono>
+#include "grammar.h"
+#include "lr.h"
+#include "table_pack.h"
+#include "lr_parser.h"
 
 using namespace std;
 
-map<char, vector<string>> productions;
-map<char, set<string>> first;
-map<char, set<string>> follow;
-
-// Function to compute FIRST set
-void computeFirst(char nt) {
-    if (!first[nt].empty()) return;  // Already computed
-
-    for (const string &prod : productions[nt]) {
-        char ch = prod[0];
-
-        // If terminal, add directly
-        if (!isupper(ch)) {
-            first[nt].insert(string(1, ch));
-        } 
-        // If non-terminal, compute FIRST recursively
-        else {
-            computeFirst(ch);
-            first[nt].insert(first[ch].begin(), first[ch].end());
+// Grammar with interned symbols; sets are bit rows over terminal indexes
+Grammar grammar;
+vector<char> nullable;
+BitMatrix first;
+BitMatrix follow;
+// LR(0) collection and the ACTION/GOTO tables built over it, with SLR(1)
+// or LALR(1) lookaheads
+LRAutomaton automaton;
+LRTables parsingTable;
+// The same tables after default reductions, row merging and row displacement
+PackedLRTables packedTable;
+bool lalr = false;
+
+// Print one set per non-terminal
+void printSets(const char* label, const BitMatrix& sets, bool withEpsilon) {
+    for (size_t nt = 0; nt < grammar.nonterminals.size(); nt++) {
+        cout << label << "(" << grammar.name(grammar.nonterminals[nt]) << ") = { ";
+        bits_for_each(sets.row(nt), sets.words(), [](int t) {
+            cout << grammar.name(grammar.terminals[t]) << " ";
+        });
+        if (withEpsilon && nullable[nt]) cout << "ε ";
+        cout << "}\n";
+    }
+}
+
+// Compute nullable, FIRST and FOLLOW for the finalized grammar
+void computeSets() {
+    GrammarAnalysis analysis = analyze(grammar);
+    nullable = move(analysis.nullable);
+    first = move(analysis.first);
+    follow = move(analysis.follow);
+}
+
+// Name of an encoded symbol (terminal t, non-terminal ~n); S' for the augmented start
+string symbolName(int32_t symbol) {
+    if (symbol >= 0) return grammar.name(grammar.terminals[symbol]);
+    if (~symbol == int(grammar.nonterminals.size())) return grammar.name(grammar.nonterminals[grammar.start]) + "'";
+    return grammar.name(grammar.nonterminals[~symbol]);
+}
+
+// Item as "A -> α . β"
+string itemText(int32_t item) {
+    int32_t p = automaton.item_production[item];
+    string text = symbolName(~automaton.lhs[p]) + " ->";
+    for (int32_t i = 0; i <= automaton.length(p); i++) {
+        if (i == automaton.dot(item)) text += " .";
+        if (i < automaton.length(p)) text += " " + symbolName(automaton.rhs_symbols[automaton.rhs_offsets[p] + i]);
+    }
+    return text;
+}
+
+string actionText(int32_t action) {
+    if (action > 0) return "s" + to_string(action - 1);
+    if (~action == parsingTable.accept_production) return "acc";
+    return "r" + to_string(~action);
+}
+
+// Build the LR(0) collection and fill ACTION/GOTO from FOLLOW sets, or
+// from LALR(1) lookaheads computed on the same states with the nullable
+// flags of analyze()
+void buildLRTable() {
+    automaton = LRAutomaton::build(grammar);
+    parsingTable = lalr ? build_lalr_tables(automaton, nullable) : build_slr_tables(automaton, follow);
+    packedTable = pack_lr_tables(parsingTable);
+}
+
+// buildLRTable(), then report every conflict
+void constructLRTable() {
+    buildLRTable();
+    for (const LRConflict& conflict : parsingTable.conflicts) {
+        cout << (conflict.shift_reduce() ? "Shift/reduce" : "Reduce/reduce") << " conflict in state "
+             << conflict.state << " on " << symbolName(conflict.terminal) << ": kept "
+             << actionText(conflict.kept) << ", dropped " << actionText(conflict.dropped) << "\n";
+    }
+}
+
+// Print the kernel of every state, then ACTION and GOTO side by side
+void displayLRTable() {
+    cout << "\nLR(0) item sets (kernels):\n";
+    for (int32_t state = 0; state < automaton.states(); state++) {
+        cout << "I" << state << ":";
+        for (int32_t k = automaton.kernel_offsets[state]; k < automaton.kernel_offsets[state + 1]; k++) {
+            cout << (k == automaton.kernel_offsets[state] ? " " : "; ") << itemText(automaton.kernel_items[k]);
+        }
+        cout << "\n";
+    }
+
+    cout << "\nProductions:\n";
+    for (size_t p = 0; p < grammar.productions.size(); p++) {
+        cout << "r" << p << ": " << grammar.name(grammar.productions[p].lhs) << " -> " << grammar.rhs_text(p) << "\n";
+    }
+
+    // $ is terminal 0 but is shown after the other terminals
+    size_t terms = grammar.terminals.size();
+    cout << (lalr ? "\nLALR(1)" : "\nSLR(1)") << " Parsing Table:\nstate |";
+    for (size_t i = 1; i <= terms; i++) cout << " " << symbolName(i % terms) << "\t|";
+    for (size_t n = 0; n < grammar.nonterminals.size(); n++) cout << " " << symbolName(~int32_t(n)) << "\t|";
+    cout << "\n";
+    for (int32_t state = 0; state < parsingTable.states; state++) {
+        cout << state << "\t|";
+        for (size_t i = 1; i <= terms; i++) {
+            int32_t action = parsingTable.action_at(state, i % terms);
+            cout << " " << (action ? actionText(action) : "") << "\t|";
+        }
+        for (size_t n = 0; n < grammar.nonterminals.size(); n++) {
+            int32_t target = parsingTable.goto_at(state, n);
+            cout << " " << (target >= 0 ? to_string(target) : "") << "\t|";
         }
+        cout << "\n";
     }
+    cout << parsingTable.states << " states, " << parsingTable.conflicts.size() << " conflicts, "
+         << parsingTable.bytes() << " table bytes\n";
+    cout << "Compressed: " << packedTable.bytes() << " bytes ("
+         << packedTable.action.merged_rows() << " distinct ACTION rows, "
+         << packedTable.go_to.merged_rows() << " distinct GOTO columns), "
+         << double(parsingTable.bytes()) / packedTable.bytes() << "x smaller\n";
 }
 
-// Function to compute FOLLOW set
-void computeFollow(char nt) {
-    if (!follow[nt].empty()) return;  // Already computed
-
-    for (map<char, vector<string>>::iterator it = productions.begin(); it != productions.end(); ++it) {
-        char lhs = it->first;
-        vector<string> rhsList = it->second;
-
-        for (const string &rhs : rhsList) {
-            size_t pos = rhs.find(nt);
-            if (pos != string::npos) {
-                if (pos + 1 < rhs.size()) {  // If there is a next symbol
-                    char next = rhs[pos + 1];
-                    if (!isupper(next)) {
-                        follow[nt].insert(string(1, next));
-                    } else {
-                        follow[nt].insert(first[next].begin(), first[next].end());
-                    }
-                } else {  // If at the end, add FOLLOW of LHS
-                    computeFollow(lhs);
-                    follow[nt].insert(follow[lhs].begin(), follow[lhs].end());
-                }
+// Whitespace separated tokens of one input, looked up in the terminal names
+class LineTokens {
+    const char* p;
+    const char* end;
+    NameTableView names;
+
+public:
+    string_view last;
+
+    LineTokens(string_view line, const NameTableView& terminals)
+        : p(line.data()), end(line.data() + line.size()), names(terminals) {}
+
+    int next() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        const char* begin = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r') p++;
+        last = string_view(begin, p - begin);
+        return last.empty() ? 0 : names.find(last);
+    }
+};
+
+void printTree(const ParseNode* node, int depth) {
+    cout << string(depth * 2, ' ') << symbolName(node->symbol) << "\n";
+    for (int32_t i = 0; i < node->count; i++) printTree(node->children[i], depth + 1);
+}
+
+// Parse every line of a file as one input with the packed tables. Each
+// tree is built in the arena, which is released before the next line.
+int parseFile(const char* path) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        cout << "Error: cannot open " << path << "\n";
+        return 1;
+    }
+    stringstream contents;
+    contents << in.rdbuf();
+    string text = contents.str();
+
+    NameTable names = terminal_names(grammar);
+    Arena arena;
+    ParseTreeBuilder<PackedLRTables> builder(packedTable, arena);
+    LRParser<PackedLRTables, const ParseNode*> parser(packedTable);
+
+    size_t inputs = 0, accepted = 0, tokens = 0, nodes = 0, peak = 0;
+    string firstError;
+    auto start = chrono::steady_clock::now();
+    for (size_t pos = 0; pos < text.size();) {
+        size_t eol = text.find('\n', pos);
+        if (eol == string::npos) eol = text.size();
+        string_view line(text.data() + pos, eol - pos);
+        pos = eol + 1;
+        if (line.find_first_not_of(" \t\r") == string_view::npos) continue;
+
+        LineTokens lineTokens(line, names.view());
+        builder.reset();
+        LRParseResult result = parser.parse(lineTokens, builder);
+        inputs++;
+        tokens += result.tokens;
+        nodes += builder.nodes;
+        peak = max(peak, arena.used());
+        if (result.accepted) {
+            accepted++;
+        } else if (firstError.empty()) {
+            string found = result.found == 0 ? string("end of input") : "'" + string(lineTokens.last) + "'";
+            if (result.found < 0) found = "unknown token " + found;
+            firstError = "input " + to_string(inputs) + ", token " + to_string(result.tokens + 1) +
+                         " (" + found + "): expected";
+            for (int32_t t = 0; t < parsingTable.terminals; t++) {
+                if (parsingTable.action_at(result.state, t) != 0) firstError += " " + symbolName(t);
             }
         }
+        // Print the first tree if it is small
+        if (inputs == 1 && result.accepted && builder.nodes <= 64) {
+            cout << "\nParse tree of the first input:\n";
+            printTree(parser.result, 0);
+        }
+        arena.release();
     }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "\nParsed " << inputs << " inputs (" << accepted << " accepted), " << tokens << " tokens, "
+         << nodes << " tree nodes in " << seconds * 1000 << " ms\n"
+         << (seconds > 0 ? inputs / seconds : 0) << " inputs/sec, "
+         << (seconds > 0 ? tokens / seconds : 0) << " tokens/sec\n"
+         << "Arena: " << peak << " bytes for the largest input, " << arena.reserved() << " bytes reserved\n";
+    if (!firstError.empty()) cout << "First syntax error: " << firstError << "\n";
+    return accepted == inputs ? 0 : 1;
 }
 
-int main() {
-    // Sample grammar input
-    productions['E'] = {"TX"};
-    productions['X'] = {"+TX", ""};  // Empty string represents epsilon
-    productions['T'] = {"FY"};
-    productions['Y'] = {"*FY", ""};
-    productions['F'] = {"(E)", "id"};
-
-    // Compute FIRST sets
-    for (map<char, vector<string>>::iterator it = productions.begin(); it != productions.end(); ++it) {
-        computeFirst(it->first);
+#ifndef GRAMMAR_BENCH
+int main(int argc, char** argv) {
+    // --lalr: LALR(1) lookaheads instead of FOLLOW sets
+    // --parse FILE: parse every line of FILE (whitespace separated terminals)
+    // FILE: read rules ("A -> x | y", one per line) instead of the sample
+    const char* path = nullptr;
+    const char* inputPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--lalr") lalr = true;
+        else if (string(argv[i]) == "--parse" && i + 1 < argc) inputPath = argv[++i];
+        else path = argv[i];
     }
 
-    // Compute FOLLOW sets (Assume 'E' is the start symbol)
-    follow['E'].insert("$");
-    for (map<char, vector<string>>::iterator it = productions.begin(); it != productions.end(); ++it) {
-        computeFollow(it->first);
+    if (path) {
+        ifstream in(path);
+        if (!in) {
+            cout << "Error: cannot open " << path << "\n";
+            return 1;
+        }
+        string line;
+        while (getline(in, line)) {
+            if (line.find_first_not_of(" \t\r") == string::npos) continue;
+            if (!grammar.add_rule(line)) {
+                cout << "Error: expected '->' in production: " << line << "\n";
+                return 1;
+            }
+        }
+    } else {
+        // Sample grammar input (E is the start symbol)
+        grammar.add_rule("E -> T X");
+        grammar.add_rule("X -> + T X | ε");
+        grammar.add_rule("T -> F Y");
+        grammar.add_rule("Y -> * F Y | ε");
+        grammar.add_rule("F -> ( E ) | id");
     }
+    grammar.finalize();
+
+    computeSets();
 
     // Print FIRST sets
     cout << "FIRST sets:\n";
-    for (map<char, set<string>>::iterator it = first.begin(); it != first.end(); ++it) {
-        cout << "FIRST(" << it->first << ") = { ";
-        for (set<string>::iterator sit = it->second.begin(); sit != it->second.end(); ++sit) {
-            cout << *sit << " ";
-        }
-        cout << "}\n";
-    }
+    printSets("FIRST", first, true);
 
     // Print FOLLOW sets
     cout << "\nFOLLOW sets:\n";
-    for (map<char, set<string>>::iterator it = follow.begin(); it != follow.end(); ++it) {
-        cout << "FOLLOW(" << it->first << ") = { ";
-        for (set<string>::iterator sit = it->second.begin(); sit != it->second.end(); ++sit) {
-            cout << *sit << " ";
-        }
-        cout << "}\n";
-    }
+    printSets("FOLLOW", follow, false);
+
+    constructLRTable();
+    displayLRTable();
 
-    return 0;
+    if (inputPath) return parseFile(inputPath);
+    return parsingTable.conflicts.empty() ? 0 : 1;
 }
+#endif
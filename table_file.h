@@ -0,0 +1,341 @@
+#ifndef TABLE_FILE_H
+#define TABLE_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "grammar.h"
+#include "ll1.h"
+
+// Binary file for computed grammar tables, loaded with mmap and used in
+// place: opening a file validates the header and section directory and
+// hands out pointers into the mapping, with no parsing or allocation.
+//
+// Layout (native byte order, checked on load):
+//
+//     Header                      magic, version, byte order, section count
+//     Entry[sections]             kind, offset and size of every section
+//     section data ...            each section starts on an 8 byte boundary
+//
+// Sections are found by kind, so a reader skips kinds it does not know and
+// new tables (e.g. LR ACTION/GOTO) can be added without a version bump.
+// The version changes only when an existing section changes its layout.
+namespace tablefile {
+
+constexpr uint32_t magic = 0x42415447;        // "GTAB"
+constexpr uint32_t version = 1;
+constexpr uint32_t byte_order = 0x01020304;   // reads differently on a foreign machine
+constexpr size_t alignment = 8;
+
+enum Section : uint32_t {
+    META = 1,              // Meta
+    TERMINAL_NAMES,        // name table: uint32 count, uint32 mask, offsets, slots, chars
+    NONTERMINAL_NAMES,     // name table
+    NULLABLE,              // uint8 per non-terminal
+    FIRST_SETS,            // uint64 rows, Meta::set_words per non-terminal
+    FOLLOW_SETS,           // uint64 rows
+    LL1_CELLS,             // int32 [nonterminals * terminals]
+    LL1_LHS,               // int32 per production
+    LL1_RHS_OFFSETS,       // int32 [productions + 1]
+    LL1_RHS_SYMBOLS,       // int32, encoded as in ll1.h
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t sections;
+};
+
+struct Entry {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;       // from the start of the file
+    uint64_t size;         // in bytes
+};
+
+struct Meta {
+    int32_t terminals;     // including "$" at index 0
+    int32_t nonterminals;
+    int32_t productions;
+    int32_t start;
+    int32_t set_words;     // words per FIRST/FOLLOW row
+    int32_t reserved;
+};
+
+// Writes a name table as one section
+inline std::string name_section(const NameTable& names) {
+    uint32_t head[2] = {uint32_t(names.offsets.size() - 1), uint32_t(names.slots.size() - 1)};
+    std::string bytes(reinterpret_cast<const char*>(head), sizeof(head));
+    bytes.append(reinterpret_cast<const char*>(names.offsets.data()), names.offsets.size() * 4);
+    bytes.append(reinterpret_cast<const char*>(names.slots.data()), names.slots.size() * 4);
+    bytes += names.chars;
+    return bytes;
+}
+
+}  // namespace tablefile
+
+// Collects sections in memory and writes them with a directory
+class TableWriter {
+    std::vector<std::pair<uint32_t, std::string>> sections;
+
+public:
+    void add(uint32_t kind, const void* data, size_t bytes) {
+        sections.emplace_back(kind, std::string(static_cast<const char*>(data), bytes));
+    }
+
+    template <class T>
+    void add(uint32_t kind, const std::vector<T>& values) {
+        add(kind, values.data(), values.size() * sizeof(T));
+    }
+
+    bool write(const char* path) const {
+        using namespace tablefile;
+        std::vector<Entry> directory(sections.size());
+        uint64_t offset = sizeof(Header) + sizeof(Entry) * sections.size();
+        for (size_t i = 0; i < sections.size(); ++i) {
+            offset = (offset + alignment - 1) & ~uint64_t(alignment - 1);
+            directory[i] = Entry{sections[i].first, 0, offset, sections[i].second.size()};
+            offset += sections[i].second.size();
+        }
+
+        FILE* out = fopen(path, "wb");
+        if (!out) return false;
+        Header header{magic, version, byte_order, uint32_t(sections.size())};
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+        ok = ok && fwrite(directory.data(), sizeof(Entry), directory.size(), out) == directory.size();
+        static const char padding[alignment] = {};
+        uint64_t written = sizeof(Header) + sizeof(Entry) * sections.size();
+        for (size_t i = 0; i < sections.size() && ok; ++i) {
+            ok = fwrite(padding, 1, directory[i].offset - written, out) == directory[i].offset - written;
+            const std::string& data = sections[i].second;
+            ok = ok && fwrite(data.data(), 1, data.size(), out) == data.size();
+            written = directory[i].offset + data.size();
+        }
+        return fclose(out) == 0 && ok;
+    }
+};
+
+// Adds everything the LL(1) driver needs: symbol names, nullable,
+// FIRST/FOLLOW rows and the parse table
+inline void add_ll1_tables(TableWriter& writer, const Grammar& g, const std::vector<char>& nullable,
+                           const BitMatrix& first, const BitMatrix& follow, const LL1Table& table) {
+    using namespace tablefile;
+    Meta meta{table.terminals, table.nonterminals, int32_t(table.lhs.size()), table.start,
+              int32_t(first.words()), 0};
+    writer.add(META, &meta, sizeof(meta));
+    std::string terminals = name_section(terminal_names(g));
+    std::string nonterminals = name_section(nonterminal_names(g));
+    writer.add(TERMINAL_NAMES, terminals.data(), terminals.size());
+    writer.add(NONTERMINAL_NAMES, nonterminals.data(), nonterminals.size());
+    writer.add(NULLABLE, nullable);
+    writer.add(FIRST_SETS, first.row(0), first.bytes());
+    writer.add(FOLLOW_SETS, follow.row(0), follow.bytes());
+    writer.add(LL1_CELLS, table.cells);
+    writer.add(LL1_LHS, table.lhs);
+    writer.add(LL1_RHS_OFFSETS, table.rhs_offsets);
+    writer.add(LL1_RHS_SYMBOLS, table.rhs_symbols);
+}
+
+// Read-only mapping of a table file. Every accessor points into the
+// mapping, which lives as long as this object.
+class MappedTables {
+    const char* base = nullptr;
+    size_t length = 0;
+    const tablefile::Header* header = nullptr;
+    const tablefile::Entry* directory = nullptr;
+    const char* problem = nullptr;
+
+    bool fail(const char* why) {
+        problem = why;
+        return false;
+    }
+
+    // Name table sections must be self-consistent before find() can trust them
+    bool check_names(uint32_t kind, uint32_t expected) {
+        size_t bytes = 0;
+        const uint32_t* head = static_cast<const uint32_t*>(section(kind, &bytes));
+        if (!head || bytes < 8) return fail("missing name table");
+        uint64_t count = head[0], slots = uint64_t(head[1]) + 1;
+        if (count != expected || (slots & (slots - 1)) || slots <= count) return fail("bad name table");
+        uint64_t fixed = 8 + (count + 1) * 4 + slots * 4;
+        if (bytes < fixed) return fail("truncated name table");
+        const uint32_t* offsets = head + 2;
+        for (uint64_t i = 0; i < count; ++i) {
+            if (offsets[i] > offsets[i + 1]) return fail("bad name table");
+        }
+        if (offsets[0] != 0 || offsets[count] != bytes - fixed) return fail("bad name table");
+        // find() probes until an empty slot, so there must be one
+        const uint32_t* slot = offsets + count + 1;
+        bool empty = false;
+        for (uint64_t i = 0; i < slots; ++i) {
+            if (slot[i] > count) return fail("bad name table");
+            empty |= slot[i] == 0;
+        }
+        if (!empty) return fail("bad name table");
+        return true;
+    }
+
+    // Every array must have exactly the size the header implies, and every
+    // stored index must be in range, so the parser never reads past the map
+    bool check() {
+        using namespace tablefile;
+        if (length < sizeof(Header)) return fail("file too small");
+        header = reinterpret_cast<const Header*>(base);
+        if (header->magic != magic) return fail("not a table file");
+        if (header->byte_order != byte_order) return fail("written on a machine with another byte order");
+        if (header->version != version) return fail("unsupported version");
+        if ((length - sizeof(Header)) / sizeof(Entry) < header->sections) return fail("truncated directory");
+        directory = reinterpret_cast<const Entry*>(base + sizeof(Header));
+        for (uint32_t i = 0; i < header->sections; ++i) {
+            const Entry& e = directory[i];
+            if (e.offset % alignment || e.offset > length || e.size > length - e.offset) {
+                return fail("section out of bounds");
+            }
+        }
+
+        const Meta* m = array<Meta>(META);
+        if (!m) return fail("missing META section");
+        if (m->terminals < 1 || m->nonterminals < 1 || m->productions < 0 ||
+            m->start < 0 || m->start >= m->nonterminals || m->set_words != int32_t(words_for(m->terminals))) {
+            return fail("bad META section");
+        }
+        if (!check_names(TERMINAL_NAMES, m->terminals) || !check_names(NONTERMINAL_NAMES, m->nonterminals)) {
+            return false;
+        }
+
+        size_t nts = m->nonterminals, terms = m->terminals, prods = m->productions;
+        size_t cells = 0, lhs = 0, offsets = 0, symbols = 0, count = 0;
+        if (!array<uint8_t>(NULLABLE, &count) || count != nts) return fail("bad NULLABLE section");
+        if (!array<uint64_t>(FIRST_SETS, &count) || count != nts * m->set_words) return fail("bad FIRST section");
+        if (!array<uint64_t>(FOLLOW_SETS, &count) || count != nts * m->set_words) return fail("bad FOLLOW section");
+
+        const int32_t* cell = array<int32_t>(LL1_CELLS, &cells);
+        const int32_t* left = array<int32_t>(LL1_LHS, &lhs);
+        const int32_t* offset = array<int32_t>(LL1_RHS_OFFSETS, &offsets);
+        const int32_t* symbol = array<int32_t>(LL1_RHS_SYMBOLS, &symbols);
+        if (!cell || !left || !offset || !symbol || cells != nts * terms || lhs != prods || offsets != prods + 1) {
+            return fail("bad LL(1) table sections");
+        }
+        for (size_t i = 0; i < cells; ++i) {
+            if (cell[i] < -1 || cell[i] >= int32_t(prods)) return fail("bad LL(1) cell");
+        }
+        for (size_t p = 0; p < prods; ++p) {
+            if (left[p] < 0 || left[p] >= int32_t(nts)) return fail("bad production");
+        }
+        if (offset[0] != 0 || size_t(offset[prods]) != symbols) return fail("bad production");
+        for (size_t p = 0; p < prods; ++p) {
+            if (offset[p] > offset[p + 1]) return fail("bad production");
+        }
+        for (size_t i = 0; i < symbols; ++i) {
+            int32_t s = symbol[i];
+            if (s >= int32_t(terms) || (s < 0 && ~s >= int32_t(nts))) return fail("bad production symbol");
+        }
+        return true;
+    }
+
+    void unmap() {
+        if (base) munmap(const_cast<char*>(base), length);
+        base = nullptr;
+        length = 0;
+        header = nullptr;
+        directory = nullptr;
+    }
+
+    static NameTableView names_at(const uint32_t* head) {
+        NameTableView v;
+        v.count = head[0];
+        v.mask = head[1];
+        v.offsets = head + 2;
+        v.slots = v.offsets + v.count + 1;
+        v.chars = reinterpret_cast<const char*>(v.slots + v.mask + 1);
+        return v;
+    }
+
+public:
+    MappedTables() = default;
+    MappedTables(const MappedTables&) = delete;
+    MappedTables& operator=(const MappedTables&) = delete;
+    ~MappedTables() { unmap(); }
+
+    // Maps and validates the file; on failure error() says why
+    bool open(const char* path) {
+        unmap();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return fail("cannot open file");
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return fail("cannot read file");
+        }
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) return fail("mmap failed");
+        base = static_cast<const char*>(map);
+        length = st.st_size;
+        if (!check()) {
+            unmap();
+            return false;
+        }
+        problem = nullptr;
+        return true;
+    }
+
+    const char* error() const { return problem; }
+
+    // Section data by kind, or nullptr if the file has none
+    const void* section(uint32_t kind, size_t* bytes = nullptr) const {
+        for (uint32_t i = 0; header && i < header->sections; ++i) {
+            if (directory[i].kind != kind) continue;
+            if (bytes) *bytes = directory[i].size;
+            return base + directory[i].offset;
+        }
+        return nullptr;
+    }
+
+    // Section as an array of T; count is the number of elements
+    template <class T>
+    const T* array(uint32_t kind, size_t* count = nullptr) const {
+        size_t bytes = 0;
+        const void* data = section(kind, &bytes);
+        if (!data || bytes % sizeof(T)) return nullptr;
+        if (count) *count = bytes / sizeof(T);
+        return static_cast<const T*>(data);
+    }
+
+    const tablefile::Meta& meta() const { return *array<tablefile::Meta>(tablefile::META); }
+
+    NameTableView terminals() const {
+        return names_at(static_cast<const uint32_t*>(section(tablefile::TERMINAL_NAMES)));
+    }
+    NameTableView nonterminals() const {
+        return names_at(static_cast<const uint32_t*>(section(tablefile::NONTERMINAL_NAMES)));
+    }
+
+    const uint8_t* nullable() const { return array<uint8_t>(tablefile::NULLABLE); }
+    const uint64_t* first(int nt) const { return array<uint64_t>(tablefile::FIRST_SETS) + size_t(nt) * meta().set_words; }
+    const uint64_t* follow(int nt) const { return array<uint64_t>(tablefile::FOLLOW_SETS) + size_t(nt) * meta().set_words; }
+
+    LL1TableView ll1() const {
+        using namespace tablefile;
+        LL1TableView v;
+        v.nonterminals = meta().nonterminals;
+        v.terminals = meta().terminals;
+        v.productions = meta().productions;
+        v.start = meta().start;
+        v.cells = array<int32_t>(LL1_CELLS);
+        v.lhs = array<int32_t>(LL1_LHS);
+        v.rhs_offsets = array<int32_t>(LL1_RHS_OFFSETS);
+        v.rhs_symbols = array<int32_t>(LL1_RHS_SYMBOLS);
+        return v;
+    }
+};
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef TABLE_PACK_H
+#define TABLE_PACK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "ll1.h"
+#include "lr.h"
+
+// Compressed parse tables: row displacement with base/check arrays.
+//
+// Every row gets a default value. Cells equal to the default, or to the
+// table's empty value, are not stored; identical rows are stored once.
+// The remaining cells of all rows are overlaid in one value array: row r
+// keeps column c at slot base[r] + c, and check[slot] == r says the slot
+// belongs to r. A lookup is two loads and a compare:
+//
+//     slot = base[row] + column
+//     check[slot] == row ? value[slot] : defaults[row]
+//
+// With the empty value as the default the packed table is exact; with any
+// other default, empty cells read back as the default instead.
+struct PackedTable {
+    int32_t rows = 0;
+    int32_t columns = 0;
+    std::vector<int32_t> row_of;     // row -> merged row
+    std::vector<int32_t> defaults;   // merged row -> value of the cells not stored
+    std::vector<int32_t> base;       // merged row -> slot of its column 0
+    std::vector<int32_t> check;      // slot -> owning merged row, -1 if free
+    std::vector<int32_t> value;      // slot -> cell value
+
+    int32_t at(int32_t row, int32_t column) const {
+        int32_t merged = row_of[row];
+        size_t slot = size_t(base[merged]) + column;
+        return check[slot] == merged ? value[slot] : defaults[merged];
+    }
+
+    int32_t merged_rows() const { return defaults.size(); }
+    size_t bytes() const {
+        return (row_of.size() + defaults.size() + base.size() + check.size() + value.size()) * sizeof(int32_t);
+    }
+};
+
+// Packs a rows x columns table. row_cells(r, scratch) returns the cells of
+// row r, either in place or copied into scratch; choose_default(cells)
+// picks the default of a row.
+template <class RowCells, class ChooseDefault>
+PackedTable pack_rows(int32_t rows, int32_t columns, int32_t empty, RowCells row_cells,
+                      ChooseDefault choose_default) {
+    PackedTable packed;
+    packed.rows = rows;
+    packed.columns = columns;
+
+    // Equivalent rows: same default and same stored cells
+    std::map<std::vector<int32_t>, int32_t> merged;
+    std::vector<std::vector<int32_t>> stored;   // merged row -> column, value pairs
+    std::vector<int32_t> key, scratch(columns);
+    for (int32_t r = 0; r < rows; ++r) {
+        const int32_t* row = row_cells(r, scratch);
+        int32_t fallback = choose_default(row);
+        key.assign(1, fallback);
+        for (int32_t c = 0; c < columns; ++c) {
+            if (row[c] == empty || row[c] == fallback) continue;
+            key.push_back(c);
+            key.push_back(row[c]);
+        }
+        auto inserted = merged.emplace(key, int32_t(stored.size()));
+        if (inserted.second) {
+            packed.defaults.push_back(fallback);
+            stored.emplace_back(key.begin() + 1, key.end());
+        }
+        packed.row_of.push_back(inserted.first->second);
+    }
+
+    // First fit, fullest rows first: they are the hardest to place
+    int32_t count = stored.size();
+    std::vector<int32_t> order(count);
+    for (int32_t m = 0; m < count; ++m) order[m] = m;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int32_t a, int32_t b) { return stored[a].size() > stored[b].size(); });
+
+    packed.base.assign(count, 0);
+    size_t first_free = 0;
+    for (int32_t m : order) {
+        const std::vector<int32_t>& entries = stored[m];
+        if (entries.empty()) continue;   // base 0: every lookup misses the check
+        while (first_free < packed.check.size() && packed.check[first_free] >= 0) first_free++;
+
+        int32_t first_column = entries[0];
+        size_t b = first_free > size_t(first_column) ? first_free - first_column : 0;
+        for (;; ++b) {
+            bool fits = true;
+            for (size_t i = 0; i < entries.size() && fits; i += 2) {
+                size_t slot = b + entries[i];
+                fits = slot >= packed.check.size() || packed.check[slot] < 0;
+            }
+            if (fits) break;
+        }
+
+        packed.base[m] = b;
+        size_t end = b + entries[entries.size() - 2] + 1;
+        if (end > packed.check.size()) {
+            packed.check.resize(end, -1);
+            packed.value.resize(end, empty);
+        }
+        for (size_t i = 0; i < entries.size(); i += 2) {
+            packed.check[b + entries[i]] = m;
+            packed.value[b + entries[i]] = entries[i + 1];
+        }
+    }
+
+    // Room for base + any column, so lookups need no bounds check
+    size_t reach = columns;
+    for (int32_t b : packed.base) reach = std::max(reach, size_t(b) + columns);
+    packed.check.resize(reach, -1);
+    packed.value.resize(reach, empty);
+    return packed;
+}
+
+// Packs a dense row-major table
+template <class ChooseDefault>
+PackedTable pack_table(const int32_t* cells, int32_t rows, int32_t columns, int32_t empty,
+                       ChooseDefault choose_default) {
+    return pack_rows(rows, columns, empty,
+                     [&](int32_t r, std::vector<int32_t>&) { return cells + size_t(r) * columns; },
+                     choose_default);
+}
+
+// Most frequent value of the cells that are not empty and pass keep, or
+// empty if there is none; ties go to the smaller value
+template <class Keep>
+int32_t most_frequent(const int32_t* cells, int32_t count, int32_t empty, Keep keep) {
+    std::vector<int32_t> values;
+    for (int32_t i = 0; i < count; ++i) {
+        if (cells[i] != empty && keep(cells[i])) values.push_back(cells[i]);
+    }
+    std::sort(values.begin(), values.end());
+    int32_t best = empty;
+    size_t best_run = 0;
+    for (size_t i = 0; i < values.size();) {
+        size_t j = i;
+        while (j < values.size() && values[j] == values[i]) j++;
+        if (j - i > best_run) {
+            best = values[i];
+            best_run = j - i;
+        }
+        i = j;
+    }
+    return best;
+}
+
+// LL(1) table packed without defaults, so errors are still detected at the
+// same token
+inline PackedTable pack_ll1_table(const LL1TableView& table) {
+    return pack_table(table.cells, table.nonterminals, table.terminals, -1,
+                      [](const int32_t*) { return -1; });
+}
+
+// LR tables packed for a shift-reduce driver.
+//
+// ACTION rows default to their most frequent reduction (never accept), so
+// a state that reduces does so on any lookahead it cannot shift; the error
+// is found before the next shift instead. GOTO is stored by non-terminal
+// with the most frequent target as default; a driver only reads GOTO
+// entries that exist.
+struct PackedLRTables {
+    int32_t states = 0;
+    int32_t terminals = 0;
+    int32_t nonterminals = 0;
+    int32_t accept_production = 0;
+    PackedTable action;                  // [state][terminal], encoded as in LRTables
+    PackedTable go_to;                   // [non-terminal][state]
+    std::vector<int32_t> lhs;
+    std::vector<int32_t> rhs_length;
+
+    int32_t action_at(int32_t state, int32_t t) const { return action.at(state, t); }
+    int32_t goto_at(int32_t state, int32_t n) const { return go_to.at(n, state); }
+    size_t bytes() const {
+        return action.bytes() + go_to.bytes() + (lhs.size() + rhs_length.size()) * sizeof(int32_t);
+    }
+};
+
+inline PackedLRTables pack_lr_tables(const LRTables& t) {
+    PackedLRTables p;
+    p.states = t.states;
+    p.terminals = t.terminals;
+    p.nonterminals = t.nonterminals;
+    p.accept_production = t.accept_production;
+    p.lhs = t.lhs;
+    p.rhs_length = t.rhs_length;
+
+    int32_t accept = ~t.accept_production;
+    p.action = pack_table(t.action.data(), t.states, t.terminals, 0, [&](const int32_t* row) {
+        return most_frequent(row, t.terminals, 0, [&](int32_t a) { return a < 0 && a != accept; });
+    });
+
+    // GOTO columns become rows
+    auto column = [&](int32_t n, std::vector<int32_t>& scratch) {
+        for (int32_t s = 0; s < t.states; ++s) scratch[s] = t.goto_at(s, n);
+        return scratch.data();
+    };
+    p.go_to = pack_rows(t.nonterminals, t.states, -1, column, [&](const int32_t* row) {
+        return most_frequent(row, t.states, -1, [](int32_t) { return true; });
+    });
+    return p;
+}
+
+#endif
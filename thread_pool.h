@@ -0,0 +1,92 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed-size pool of worker threads. Tasks may submit further tasks;
+// wait() returns once every submitted task, including those, has finished.
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex lock;
+    std::condition_variable task_ready;
+    std::condition_variable all_done;
+    size_t unfinished = 0;
+    bool stopping = false;
+
+    void work() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                task_ready.wait(guard, [&] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (--unfinished == 0) all_done.notify_all();
+            }
+        }
+    }
+
+public:
+    // 0 workers means one per hardware thread
+    explicit ThreadPool(unsigned count = 0) {
+        if (count == 0) count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < count; ++i) workers.emplace_back([this] { work(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        task_ready.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return workers.size(); }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            tasks.push_back(std::move(task));
+            unfinished++;
+        }
+        task_ready.notify_one();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        all_done.wait(guard, [&] { return unfinished == 0; });
+    }
+
+    // Runs f(chunk, begin, end) over [0, n) split into at most `chunks`
+    // contiguous ranges (default: one per worker) and waits for all of them
+    template <class F>
+    void parallel_for(size_t n, F f, size_t chunks = 0) {
+        if (chunks == 0) chunks = workers.size();
+        chunks = std::max<size_t>(1, std::min(chunks, n));
+        size_t step = (n + chunks - 1) / std::max<size_t>(chunks, 1);
+        for (size_t c = 0; c * step < n; ++c) {
+            size_t begin = c * step, end = std::min(n, begin + step);
+            submit([=, &f] { f(c, begin, end); });
+        }
+        wait();
+    }
+};
+
+#endif